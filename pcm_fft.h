@@ -0,0 +1,298 @@
+/* PCM FFT (pcm_fft.h)
+ *
+ * A radix-2 fast Fourier transform for power-of-two sizes. The twiddle factors and bit-reversal
+ * order are worked out once, in a PCMFFT plan, and then used for every transform of that size.
+ * Complex data is kept as separate real and imaginary arrays.
+ *
+ * Batched transforms run a plan over many arrays laid end-to-end. This is how a whole wavetable
+ * (16 frames) is transformed in one call.
+ *
+ * pcm_fft_new() creates a PCMFFT plan for a size.
+ *
+ * pcm_fft_forward() and pcm_fft_inverse() transform one array, in place.
+ *
+ * pcm_fft_forward_batch() and pcm_fft_inverse_batch() transform many arrays, in place.
+ *
+ * pcm_fft_load() copies PCM samples into real and imaginary arrays, ready for a transform.
+ *
+ * pcm_fft_hann() applies a Hann window to a real array.
+ *
+ * pcm_fft_free() frees a PCMFFT plan.
+ *
+ * pcm_spectral_morph() makes any number of in-between waveforms from two waveforms, by
+ *     interpolating their spectra rather than their samples.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_FFT_H_
+#include <math.h>
+#include "pcm_proc.h"
+#define PCM_FFT_H_
+
+/* PCMFFT is a plan for transforms of one size */
+typedef struct _PCM_FFT {
+    int size; /* Number of points, a power of two */
+    float *cos_table; /* size / 2 twiddle factors */
+    float *sin_table;
+    int *bitrev; /* Bit-reversed index of each point */
+} PCMFFT;
+
+/* Function declarations */
+PCMFFT *pcm_fft_new(int size);
+void pcm_fft_forward(PCMFFT *fft, float re[], float im[]);
+void pcm_fft_inverse(PCMFFT *fft, float re[], float im[]);
+void pcm_fft_forward_batch(PCMFFT *fft, float re[], float im[], int count);
+void pcm_fft_inverse_batch(PCMFFT *fft, float re[], float im[], int count);
+void pcm_fft_load(PCMFFT *fft, const pcm_sample_t data[], float re[], float im[]);
+void pcm_fft_hann(PCMFFT *fft, float re[]);
+void pcm_fft_free(PCMFFT *fft);
+int pcm_spectral_morph(PCMFFT *fft, const pcm_sample_t start[], const pcm_sample_t end[], const float scale[],
+                       int count, int resolution, pcm_sample_t out[]);
+
+/* Creates a PCMFFT plan. Returns NULL if size isn't a power of two, or if there's no memory. */
+PCMFFT *pcm_fft_new(int size)
+{
+    if (size < 2 || (size & (size - 1))) return NULL;
+
+    PCMFFT *fft = (PCMFFT *) malloc(sizeof(PCMFFT));
+    if (fft == NULL) return NULL;
+    fft->size = size;
+    fft->cos_table = (float *) malloc(sizeof(float) * (size / 2));
+    fft->sin_table = (float *) malloc(sizeof(float) * (size / 2));
+    fft->bitrev = (int *) malloc(sizeof(int) * size);
+    if (fft->cos_table == NULL || fft->sin_table == NULL || fft->bitrev == NULL) {
+        pcm_fft_free(fft);
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < size / 2; i++)
+    {
+        fft->cos_table[i] = (float) cos(2.0 * M_PI * i / size);
+        fft->sin_table[i] = (float) -sin(2.0 * M_PI * i / size);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < size) bits++;
+    for (i = 0; i < size; i++)
+    {
+        int r = 0;
+        int b;
+        for (b = 0; b < bits; b++) if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        fft->bitrev[i] = r;
+    }
+
+    return fft;
+}
+
+/* The transform itself. sign is 1 for forward and -1 for inverse. */
+void _pcm_fft_transform(PCMFFT *fft, float re[], float im[], int sign)
+{
+    int n = fft->size;
+    int i;
+    for (i = 0; i < n; i++)
+    {
+        int r = fft->bitrev[i];
+        if (r > i) {
+            float t = re[i]; re[i] = re[r]; re[r] = t;
+            t = im[i]; im[i] = im[r]; im[r] = t;
+        }
+    }
+
+    int len;
+    for (len = 2; len <= n; len <<= 1)
+    {
+        int half = len / 2;
+        int step = n / len; /* Stride through the twiddle tables */
+        int start;
+        for (start = 0; start < n; start += len)
+        {
+            int k;
+            for (k = 0; k < half; k++)
+            {
+                float wr = fft->cos_table[k * step];
+                float wi = fft->sin_table[k * step] * sign;
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* Forward transform of size points, in place */
+void pcm_fft_forward(PCMFFT *fft, float re[], float im[])
+{
+    _pcm_fft_transform(fft, re, im, 1);
+}
+
+/* Inverse transform of size points, in place. The result is scaled by 1 / size, so that a
+ * forward transform followed by an inverse transform gives back the original data.
+ */
+void pcm_fft_inverse(PCMFFT *fft, float re[], float im[])
+{
+    _pcm_fft_transform(fft, re, im, -1);
+    float scale = 1.0f / fft->size;
+    int i;
+    for (i = 0; i < fft->size; i++)
+    {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
+
+/* Forward transforms of count arrays of size points, laid end-to-end, in place */
+void pcm_fft_forward_batch(PCMFFT *fft, float re[], float im[], int count)
+{
+    int c;
+    for (c = 0; c < count; c++) pcm_fft_forward(fft, re + (c * fft->size), im + (c * fft->size));
+}
+
+/* Inverse transforms of count arrays of size points, laid end-to-end, in place */
+void pcm_fft_inverse_batch(PCMFFT *fft, float re[], float im[], int count)
+{
+    int c;
+    for (c = 0; c < count; c++) pcm_fft_inverse(fft, re + (c * fft->size), im + (c * fft->size));
+}
+
+/* Copies size samples of PCM data into re[], and clears im[] */
+void pcm_fft_load(PCMFFT *fft, const pcm_sample_t data[], float re[], float im[])
+{
+    int i;
+    for (i = 0; i < fft->size; i++)
+    {
+        re[i] = (float) data[i];
+        im[i] = 0;
+    }
+}
+
+/* Applies a Hann window to size points of real data, for analysis of non-periodic audio */
+void pcm_fft_hann(PCMFFT *fft, float re[])
+{
+    int i;
+    for (i = 0; i < fft->size; i++)
+    {
+        re[i] *= (float) (0.5 - 0.5 * cos(2.0 * M_PI * i / fft->size));
+    }
+}
+
+/* Frees a PCMFFT plan */
+void pcm_fft_free(PCMFFT *fft)
+{
+    if (fft == NULL) return;
+    free(fft->cos_table);
+    free(fft->sin_table);
+    free(fft->bitrev);
+    free(fft);
+}
+
+/*
+ * Makes count in-between waveforms, each fft->size samples, from the start and end waveforms.
+ * Waveform j is at scale[j] from start (0) to end (1), and goes into out[] at j * fft->size.
+ *
+ * Linear morphing in the time domain cancels out harmonics whose phases differ between the two
+ * waveforms, so the middle of the morph loses level. Here, each harmonic's magnitude is
+ * interpolated, and its phase is turned the shorter way around from the start phase to the end
+ * phase, so every harmonic keeps its level all the way through. The two forward transforms are
+ * done once, and then all count inverse transforms are done in one batch.
+ *
+ * Samples are rounded and clamped to the signed range of the resolution. Returns 1, or 0 if
+ * there's no memory.
+ */
+int pcm_spectral_morph(PCMFFT *fft, const pcm_sample_t start[], const pcm_sample_t end[], const float scale[],
+                       int count, int resolution, pcm_sample_t out[])
+{
+    int n = fft->size;
+    float *re = (float *) malloc(sizeof(float) * n * (count + 2));
+    float *im = (float *) malloc(sizeof(float) * n * (count + 2));
+    if (re == NULL || im == NULL) {
+        free(re);
+        free(im);
+        return 0;
+    }
+
+    /* The two key waveforms go after the in-between waveforms */
+    float *sre = re + (n * count);
+    float *sim = im + (n * count);
+    float *ere = sre + n;
+    float *eim = sim + n;
+    pcm_fft_load(fft, start, sre, sim);
+    pcm_fft_load(fft, end, ere, eim);
+    pcm_fft_forward_batch(fft, sre, sim, 2);
+
+    int j;
+    for (j = 0; j < count; j++)
+    {
+        float s = scale[j];
+        float *wre = re + (n * j);
+        float *wim = im + (n * j);
+
+        /* DC and Nyquist are real, so they're interpolated as they are */
+        wre[0] = sre[0] + (ere[0] - sre[0]) * s;
+        wre[n / 2] = sre[n / 2] + (ere[n / 2] - sre[n / 2]) * s;
+        wim[0] = wim[n / 2] = 0;
+
+        int k;
+        for (k = 1; k < n / 2; k++)
+        {
+            float smag = sqrtf(sre[k] * sre[k] + sim[k] * sim[k]);
+            float emag = sqrtf(ere[k] * ere[k] + eim[k] * eim[k]);
+            float sph = atan2f(sim[k], sre[k]);
+            float dph = atan2f(eim[k], ere[k]) - sph;
+            if (dph > M_PI) dph -= 2 * M_PI;
+            if (dph < -M_PI) dph += 2 * M_PI;
+
+            float mag = smag + (emag - smag) * s;
+            float ph = sph + dph * s;
+            wre[k] = mag * cosf(ph);
+            wim[k] = mag * sinf(ph);
+            wre[n - k] = wre[k]; /* The spectrum of real data is conjugate-symmetric */
+            wim[n - k] = -wim[k];
+        }
+    }
+    pcm_fft_inverse_batch(fft, re, im, count);
+
+    float max = (float) ((1UL << (resolution - 1)) - 1);
+    int i;
+    for (i = 0; i < n * count; i++)
+    {
+        float v = re[i];
+        if (v > max) v = max;
+        if (v < -1 - max) v = -1 - max;
+        out[i] = (pcm_sample_t) lrintf(v);
+    }
+
+    free(re);
+    free(im);
+    return 1;
+}
+
+#endif /* PCM_FFT_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -0,0 +1,229 @@
+/* PCM Fixed-Point (pcm_fixed.h)
+ *
+ * Fixed-point versions of the pcm_proc operations that use float math for each sample, for
+ * builds without an FPU, or that need the same results on every platform. Proportions (a morph
+ * scale or a normalization amplitude) are Q15 values, where PCM_Q15_ONE is 1.0. Everything is
+ * done with integer math whose results are defined by the C standard, so the output is
+ * bit-exact everywhere; it's within one LSB of the float version.
+ *
+ * Midpoint interpolation works on pairs of 16-bit samples packed into 32-bit words (SWAR), so
+ * each 32-bit operation makes two samples.
+ *
+ * pcm_q15_ratio() returns the Q15 value of a ratio of two integers.
+ *
+ * pcm_change_size_fixed() is pcm_change_size() in fixed point.
+ *
+ * pcm_normalize_fixed() is pcm_normalize() in fixed point.
+ *
+ * pcm_morph_fixed() is pcm_morph() in fixed point.
+ *
+ * pcm_q15_lerp() interpolates between two arrays of samples in fixed point.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_FIXED_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include "pcm_proc.h"
+#define PCM_FIXED_H_
+
+/* 1.0 in Q15 */
+#define PCM_Q15_ONE 32768
+
+/* Q15 proportions */
+typedef int32_t pcm_q15_t;
+
+/* Function declarations */
+pcm_q15_t pcm_q15_ratio(long num, long den);
+void pcm_change_size_fixed(PCMData *pcm, pcm_size_t new_size);
+void pcm_normalize_fixed(PCMData *pcm, pcm_q15_t new_amplitude);
+PCMData pcm_morph_fixed(PCMData *start, PCMData *end, pcm_q15_t scale);
+void pcm_q15_lerp(const pcm_sample_t a[], const pcm_sample_t b[], pcm_sample_t out[], pcm_size_t size, pcm_q15_t scale);
+
+/* Returns num / den in Q15, rounded to nearest */
+pcm_q15_t pcm_q15_ratio(long num, long den)
+{
+    if (den == 0) return 0;
+    int64_t q = ((int64_t) num * PCM_Q15_ONE * 2 + den) / (2 * (int64_t) den);
+    return (pcm_q15_t) q;
+}
+
+/* Adds the halves of two words without carrying from the low half into the high half */
+uint32_t _pcm_swar_add(uint32_t a, uint32_t b)
+{
+    return ((a & 0x7fff7fffUL) + (b & 0x7fff7fffUL)) ^ ((a ^ b) & 0x80008000UL);
+}
+
+/* Divides each signed half of a word by two, rounding toward zero as C division does */
+uint32_t _pcm_swar_half(uint32_t a)
+{
+    uint32_t sign = (a >> 15) & 0x00010001UL; /* 1 in each half that's negative */
+    a = _pcm_swar_add(a, sign);
+    return ((a >> 1) & 0x7fff7fffUL) | (a & 0x80008000UL);
+}
+
+/*
+ * Returns the midpoints of two pairs of signed 16-bit samples, packed into 32-bit words, as
+ * (a / 2) + (b / 2) in each half. That's exactly what pcm_change_size() computes, so the
+ * expanded data matches it sample for sample.
+ */
+uint32_t _pcm_swar_mid(uint32_t a, uint32_t b)
+{
+    return _pcm_swar_add(_pcm_swar_half(a), _pcm_swar_half(b));
+}
+
+/* Packs two samples into a word, first sample in the low half */
+uint32_t _pcm_swar_pack(int16_t lo, int16_t hi)
+{
+    return (uint32_t) (uint16_t) lo | ((uint32_t) (uint16_t) hi << 16);
+}
+
+/*
+ * Doubles the length of n 16-bit samples (less one) by putting the midpoint between each pair
+ * of samples. out[] needs room for (2 * n) - 1 samples. Two midpoints come from each SWAR step.
+ */
+pcm_size_t _pcm_fixed_expand(const int16_t in[], pcm_size_t n, int16_t out[])
+{
+    pcm_index_t i = 0;
+    for (; i + 2 < n; i += 2)
+    {
+        uint32_t left = _pcm_swar_pack(in[i], in[i + 1]); /* Each pair's first sample */
+        uint32_t right = _pcm_swar_pack(in[i + 1], in[i + 2]); /* Each pair's second sample */
+        uint32_t mid = _pcm_swar_mid(left, right);
+        out[2 * i] = in[i];
+        out[2 * i + 1] = (int16_t) (uint16_t) (mid & 0xffff);
+        out[2 * i + 2] = in[i + 1];
+        out[2 * i + 3] = (int16_t) (uint16_t) (mid >> 16);
+    }
+    for (; i < n; i++)
+    {
+        out[2 * i] = in[i];
+        if (i + 1 < n) {
+            uint32_t mid = _pcm_swar_mid(_pcm_swar_pack(in[i], 0), _pcm_swar_pack(in[i + 1], 0));
+            out[2 * i + 1] = (int16_t) (uint16_t) (mid & 0xffff);
+        }
+    }
+    return n ? (2 * n) - 1 : 0;
+}
+
+/*
+ * Changes the size of the PCMData passed by reference, in the same way as pcm_change_size():
+ * expand by midpoint interpolation until the size is at least the new size, and then collapse
+ * into equally-spaced samples. The spacing is worked out with integer division rather than a
+ * float increment. As with pcm_change_size(), the samples are treated as 16-bit. The work arrays
+ * are on the heap; if they can't be allocated, the PCMData is left as it was.
+ */
+void pcm_change_size_fixed(PCMData *pcm, pcm_size_t new_size)
+{
+    if (new_size > (pcm_size_t) (PCM_PROC_MAX / pcm->channels)) new_size = PCM_PROC_MAX / pcm->channels;
+    if (pcm->size < 2) return;
+
+    int16_t (*work)[PCM_PROC_MAX] = (int16_t (*)[PCM_PROC_MAX]) malloc(sizeof(int16_t) * 2 * PCM_PROC_MAX);
+    pcm_sample_t *resized = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * PCM_PROC_MAX);
+    if (work == NULL || resized == NULL) {
+        free(work);
+        free(resized);
+        return;
+    }
+    int ch;
+    for (ch = 0; ch < pcm->channels; ch++)
+    {
+        /* Take this channel out into a 16-bit work array */
+        int w = 0; /* Which work array holds the current data */
+        pcm_size_t size = pcm->size;
+        pcm_index_t i;
+        for (i = 0; i < size; i++) work[w][i] = (int16_t) pcm->data[i * pcm->channels + ch];
+
+        while (size < new_size && (2 * size) - 1 <= PCM_PROC_MAX)
+        {
+            size = _pcm_fixed_expand(work[w], size, work[!w]);
+            w = !w;
+        }
+
+        for (i = 0; i < new_size; i++)
+        {
+            pcm_index_t ix = (pcm_index_t) (((uint64_t) i * size) / new_size);
+            resized[i * pcm->channels + ch] = work[w][ix];
+        }
+    }
+    set_pcm_data(pcm, new_size * pcm->channels, resized);
+    free(work);
+    free(resized);
+}
+
+/*
+ * Normalizes the PCM amplitude to a Q15 proportion of the maximum possible amplitude, based on
+ * the PCMData's resolution. The amplitude is limited to PCM_Q15_ONE (full scale). The gain is
+ * worked out once, as a Q31 value, and each sample is multiplied by it in 64 bits. A sample is
+ * never more than the peak, so the gain's rounding error moves it by less than one LSB, and the
+ * result is within one LSB of the float version at every resolution up to 32 bits.
+ */
+void pcm_normalize_fixed(PCMData *pcm, pcm_q15_t new_amplitude)
+{
+    int64_t max = ((int64_t) 1 << (pcm->resolution - 1)) - 1; /* Largest sample value based on resolution */
+    int64_t peak = pcm_slice_peak(pcm_slice_of(pcm));
+    if (peak == 0) return;
+    if (new_amplitude > PCM_Q15_ONE) new_amplitude = PCM_Q15_ONE;
+
+    /* max * new_amplitude is at most 46 bits, so there's room to shift it up to Q31 */
+    int64_t gain = ((max * new_amplitude) << 16) / peak; /* Q31 */
+    int64_t one = (int64_t) 1 << 31;
+    pcm_index_t i;
+    for (i = 0; i < (pcm->size * pcm->channels); i++)
+    {
+        pcm->data[i] = (pcm_sample_t) (((int64_t) pcm->data[i] * gain) / one);
+    }
+}
+
+/*
+ * Interpolates between a[] and b[] by a Q15 scale, into out[], which may be the same array as
+ * a[] or b[]. Each sample is a + ((b - a) * scale), worked out in 64 bits (so any resolution
+ * works) and rounded toward zero, as the float version's cast does.
+ */
+void pcm_q15_lerp(const pcm_sample_t a[], const pcm_sample_t b[], pcm_sample_t out[], pcm_size_t size, pcm_q15_t scale)
+{
+    pcm_index_t i;
+    for (i = 0; i < size; i++)
+    {
+        int64_t diff = (int64_t) b[i] - a[i];
+        out[i] = (pcm_sample_t) (((int64_t) a[i] * PCM_Q15_ONE + diff * scale) / PCM_Q15_ONE);
+    }
+}
+
+/* Returns a PCM waveform that is a partial morph between the start PCM wave and the end PCM
+ * wave, at the specified Q15 scale from >0 to <PCM_Q15_ONE
+ */
+PCMData pcm_morph_fixed(PCMData *start, PCMData *end, pcm_q15_t scale)
+{
+    PCMData morphed = new_PCMData();
+    morphed.channels = start->channels;
+    morphed.rate = start->rate;
+    pcm_q15_lerp(start->data, end->data, morphed.data, start->size * start->channels, scale);
+    morphed.size = start->size;
+    return morphed;
+}
+
+#endif /* PCM_FIXED_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
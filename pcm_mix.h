@@ -0,0 +1,241 @@
+/* PCM Mixer (pcm_mix.h)
+ *
+ * Channel mixing for PCM data: downmixing any number of channels to any other number, with
+ * equal weights or a gain matrix, and mid/side encoding and decoding. Each function reads its
+ * source once and writes the mixed frames straight into the destination, so there are no
+ * intermediate PCMData copies. The sources are PCMSlice views, so a mix can be taken from a
+ * range or a channel subset of a recording without trimming it first.
+ *
+ * pcm_mix_matrix() mixes N channels to M channels with a gain matrix.
+ *
+ * pcm_mix_planar() is pcm_mix_matrix() for planar (one array per channel) data.
+ *
+ * pcm_mix_down() mixes all channels to mono, with equal weights.
+ *
+ * pcm_mid_side_encode() converts left/right stereo to mid/side stereo.
+ *
+ * pcm_mid_side_decode() converts mid/side stereo back to left/right stereo.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_MIX_H_
+#include <math.h>
+#include "pcm_proc.h"
+#define PCM_MIX_H_
+
+/* The most channels that can be mixed from or to */
+#define PCM_MIX_MAX_CHANNELS 64
+
+/* Function declarations */
+void pcm_mix_matrix(PCMSlice src, PCMData *dst, int out_channels, const float gains[]);
+void pcm_mix_planar(const pcm_sample_t *const in[], int in_channels, pcm_sample_t *out[], int out_channels,
+                    pcm_size_t frames, int resolution, const float gains[]);
+void pcm_mix_down(PCMSlice src, PCMData *dst);
+void pcm_mid_side_encode(PCMSlice src, PCMData *dst);
+void pcm_mid_side_decode(PCMSlice src, PCMData *dst);
+
+/* 8-bit PCM is unsigned, so it's offset by this much. Everything else is signed. */
+pcm_sample_t _pcm_mix_offset(int resolution)
+{
+    return (resolution == 8) ? 128 : 0;
+}
+
+/* Rounds a mixed value and clamps it to the signed range of the resolution. The clamp is done
+ * in double, because a float can't hold the largest 32-bit sample, and would round it up to 2^31.
+ */
+pcm_sample_t _pcm_mix_clamp(double v, int resolution)
+{
+    double max = (double) ((1UL << (resolution - 1)) - 1);
+    if (v > max) v = max;
+    if (v < -1 - max) v = -1 - max;
+    return (pcm_sample_t) lrint(v);
+}
+
+/* Sets up the destination PCMData for the mix */
+void _pcm_mix_dst(PCMSlice src, PCMData *dst, int out_channels)
+{
+    dst->size = src.size;
+    dst->channels = out_channels;
+    dst->resolution = src.resolution;
+    dst->rate = src.rate;
+    if (dst->size * out_channels > PCM_PROC_MAX) dst->size = PCM_PROC_MAX / out_channels;
+}
+
+/*
+ * Mixes the channels of a PCMSlice into out_channels channels in the PCMData passed by
+ * reference. gains is an out_channels x src.channels matrix, by rows, so that
+ *
+ *   out[o] = sum of (gains[o * src.channels + i] * in[i])
+ *
+ * Example (stereo to mono, favoring the left channel):
+ *
+ *   float gains[] = {0.75, 0.25};
+ *   pcm_mix_matrix(pcm_slice_of(&stereo), &mono, 1, gains);
+ *
+ * The source may be a slice of the destination itself. When that mix has more output channels
+ * than the source's stride, the frames are mixed into a temporary buffer first, so that no frame
+ * is overwritten before it's read; if that buffer can't be allocated, the destination is left
+ * as it was. Nothing is done if either channel count is less than 1 or more than
+ * PCM_MIX_MAX_CHANNELS.
+ */
+void pcm_mix_matrix(PCMSlice src, PCMData *dst, int out_channels, const float gains[])
+{
+    if (out_channels < 1 || out_channels > PCM_MIX_MAX_CHANNELS) return;
+    if (src.channels < 1 || src.channels > PCM_MIX_MAX_CHANNELS) return;
+
+    /* Mixing forward in place is safe as long as each output frame is no wider than an input frame */
+    pcm_sample_t *out = dst->data;
+    int in_place = (src.data >= dst->data && src.data < dst->data + PCM_PROC_MAX);
+    if (in_place && out_channels > src.stride) {
+        out = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * PCM_PROC_MAX);
+        if (out == NULL) return;
+    }
+
+    _pcm_mix_dst(src, dst, out_channels);
+    pcm_sample_t offset = _pcm_mix_offset(src.resolution);
+
+    float in[PCM_MIX_MAX_CHANNELS];
+    pcm_index_t ix = 0; /* Index within the destination data */
+    pcm_index_t i;
+    for (i = 0; i < dst->size; i++)
+    {
+        const pcm_sample_t *frame = src.data + (i * src.stride);
+        int ch;
+        for (ch = 0; ch < src.channels; ch++) in[ch] = (float) (frame[ch] - offset);
+
+        int o;
+        for (o = 0; o < out_channels; o++)
+        {
+            const float *row = gains + (o * src.channels);
+            float v = 0;
+            for (ch = 0; ch < src.channels; ch++) v += row[ch] * in[ch];
+            out[ix++] = _pcm_mix_clamp(v, src.resolution) + offset;
+        }
+    }
+
+    if (out != dst->data) {
+        for (i = 0; i < ix; i++) dst->data[i] = out[i];
+        free(out);
+    }
+}
+
+/*
+ * Mixes planar data. in[] and out[] are arrays of channel arrays, each frames long. The gain
+ * matrix is the same as for pcm_mix_matrix(). Each output channel is built a whole channel at a
+ * time, with the inner loop running straight down the input channel arrays.
+ */
+void pcm_mix_planar(const pcm_sample_t *const in[], int in_channels, pcm_sample_t *out[], int out_channels,
+                    pcm_size_t frames, int resolution, const float gains[])
+{
+    pcm_sample_t offset = _pcm_mix_offset(resolution);
+    int o;
+    for (o = 0; o < out_channels; o++)
+    {
+        const float *row = gains + (o * in_channels);
+        pcm_sample_t *dst = out[o];
+        pcm_index_t i;
+        for (i = 0; i < frames; i++)
+        {
+            float v = 0;
+            int ch;
+            for (ch = 0; ch < in_channels; ch++) v += row[ch] * (float) (in[ch][i] - offset);
+            dst[i] = _pcm_mix_clamp(v, resolution) + offset;
+        }
+    }
+}
+
+/*
+ * Mixes all of the channels of a PCMSlice into a mono PCMData, with equal weights. Unlike
+ * pcm_from_channel(), nothing is thrown away.
+ */
+void pcm_mix_down(PCMSlice src, PCMData *dst)
+{
+    if (src.channels < 1) return;
+    _pcm_mix_dst(src, dst, 1);
+    pcm_sample_t offset = _pcm_mix_offset(src.resolution);
+    float gain = 1.0f / src.channels;
+
+    pcm_index_t i;
+    if (src.channels == 2 && src.stride == 2) {
+        /* Stereo is by far the most common case, so it gets its own straight-line loop */
+        for (i = 0; i < dst->size; i++)
+        {
+            float v = (float) (src.data[2 * i] - offset) + (float) (src.data[2 * i + 1] - offset);
+            dst->data[i] = _pcm_mix_clamp(v * gain, src.resolution) + offset;
+        }
+    } else {
+        for (i = 0; i < dst->size; i++)
+        {
+            const pcm_sample_t *frame = src.data + (i * src.stride);
+            float v = 0;
+            int ch;
+            for (ch = 0; ch < src.channels; ch++) v += (float) (frame[ch] - offset);
+            dst->data[i] = _pcm_mix_clamp(v * gain, src.resolution) + offset;
+        }
+    }
+}
+
+/*
+ * Converts a left/right stereo PCMSlice to mid/side stereo in the PCMData passed by reference.
+ * The mid channel is (L + R) / 2 and the side channel is (L - R) / 2, so decoding gets back
+ * to within one LSB of the original.
+ */
+void pcm_mid_side_encode(PCMSlice src, PCMData *dst)
+{
+    if (src.channels != 2) return;
+    _pcm_mix_dst(src, dst, 2);
+    pcm_sample_t offset = _pcm_mix_offset(src.resolution);
+
+    pcm_index_t i;
+    for (i = 0; i < dst->size; i++)
+    {
+        const pcm_sample_t *frame = src.data + (i * src.stride);
+        float l = (float) (frame[PCM_PROC_CHANNEL_LEFT] - offset);
+        float r = (float) (frame[PCM_PROC_CHANNEL_RIGHT] - offset);
+        dst->data[2 * i] = _pcm_mix_clamp((l + r) * 0.5f, src.resolution) + offset;
+        dst->data[2 * i + 1] = _pcm_mix_clamp((l - r) * 0.5f, src.resolution) + offset;
+    }
+}
+
+/* Converts a mid/side stereo PCMSlice back to left/right stereo, in the PCMData passed by reference */
+void pcm_mid_side_decode(PCMSlice src, PCMData *dst)
+{
+    if (src.channels != 2) return;
+    _pcm_mix_dst(src, dst, 2);
+    pcm_sample_t offset = _pcm_mix_offset(src.resolution);
+
+    pcm_index_t i;
+    for (i = 0; i < dst->size; i++)
+    {
+        const pcm_sample_t *frame = src.data + (i * src.stride);
+        float m = (float) (frame[0] - offset);
+        float s = (float) (frame[1] - offset);
+        dst->data[2 * i + PCM_PROC_CHANNEL_LEFT] = _pcm_mix_clamp(m + s, src.resolution) + offset;
+        dst->data[2 * i + PCM_PROC_CHANNEL_RIGHT] = _pcm_mix_clamp(m - s, src.resolution) + offset;
+    }
+}
+
+#endif /* PCM_MIX_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -33,6 +33,42 @@
      * pcm_gen_saw() generates a 1024-sample sawtooth waveform
      * 
      * pcm_gen_square() generates a 1024-sample square waveform
+     *
+     * pcm_slice() returns a non-owning PCMSlice view of a range of PCM data, without copying.
+     *
+     * pcm_slice_of() returns a PCMSlice view of all the data in a PCMData struct.
+     *
+     * pcm_slice_channel() narrows a PCMSlice to a single channel, without copying.
+     *
+     * pcm_slice_trim() narrows a PCMSlice to a range of frames, without copying.
+     *
+     * pcm_slice_peak() finds the largest absolute sample value in a PCMSlice.
+     *
+     * pcm_slice_copy() materializes a PCMSlice into a new PCMData struct.
+     *
+     * pcm_slice_morph() is pcm_morph() for PCMSlice views.
+     *
+     * pcm_ref_new() puts PCM data into reference-counted, copy-on-write storage.
+     *
+     * pcm_ref_share() returns another reference to the same storage, without copying.
+     *
+     * pcm_ref_read() and pcm_ref_slice() give read-only access to the shared data.
+     *
+     * pcm_ref_write() gives write access to the data, copying it first if it's shared.
+     *
+     * pcm_ref_release() gives up a reference, freeing the storage when it's no longer used.
+     *
+     * A reference whose pcm_ref_new() failed has a NULL store. pcm_ref_read() and
+     * pcm_ref_write() return NULL for it, and pcm_ref_slice() returns an empty slice. For example,
+     * to keep one capture and hand out versions of it:
+     *
+     *   PCMRef capture = pcm_ref_new(&pcm);
+     *   if (capture.store == NULL) return; // No memory
+     *   PCMRef loud = pcm_ref_share(capture); // No copy yet
+     *   PCMData *edit = pcm_ref_write(&loud); // Copied here, so capture is unchanged
+     *   if (edit) pcm_normalize(edit, 1.0);
+     *   pcm_ref_release(&loud);
+     *   pcm_ref_release(&capture);
      * 
      * Please see the bottom for boring license information.
      */
@@ -43,33 +79,83 @@
     #define PCM_PROC_MAX 131072
     #define PCM_PROC_CHANNEL_LEFT 0
     #define PCM_PROC_CHANNEL_RIGHT 1
+    #define PCM_PROC_DEFAULT_RATE 44100
 
-    /* Offsets for channel and resolution bytes in format chunk */
+    /* Offsets for channel, sample rate, and resolution bytes in format chunk */
     #define WAV_CHANNEL_OFFSET 7
+    #define WAV_RATE_OFFSET 9
     #define WAV_RESOLUTION_OFFSET 19
 
+    /* Offset for the 64-bit data size in an RF64 file's ds64 chunk */
+    #define WAV_DS64_DATA_OFFSET 13
+
+    /* Sony Wave64 chunk headers are a 16-byte GUID and an 8-byte size, rather than a 4-byte ID
+     * and a 4-byte size, so everything after a chunk's ID is this much further along.
+     */
+    #define WAV_W64_HEADER_EXTRA 16
+    #define WAV_W64_HEADER_SIZE 24
+
     /* Frequently-used types in this library */
     typedef unsigned long int pcm_index_t;
     typedef unsigned long int pcm_size_t;
     typedef signed int pcm_sample_t;
 
+    /* Positions and sizes within files and streams, which may be much larger than anything held
+     * in a PCMData (an RF64 or Wave64 file may be well over 4 GB), so these are always 64 bits.
+     */
+    typedef unsigned long long int pcm_offset_t;
+
     /* PCMData is the primary operating structure for this library. It contains PCM data, and
-     * keeps track of the resolution (16-bit, 24-bit, 32-bit) and number of channels. Note that
-     * size is the number of samples per channel rather than the total size.
+     * keeps track of the resolution (16-bit, 24-bit, 32-bit), number of channels, and sample
+     * rate. Note that size is the number of samples per channel rather than the total size.
      */
     typedef struct _PCM_DATA {
        pcm_size_t size; /* Number of samples per channel */
        pcm_sample_t data[PCM_PROC_MAX];
        int channels;
        int resolution;
+       long rate; /* Samples per second, per channel */
     } PCMData;
 
+    /* PCMSlice is a non-owning view into PCM data owned by something else (usually a PCMData).
+     * Taking a slice is O(1), so a recording can be cut into any number of candidate regions
+     * without copying. Frames are stride samples apart, and the samples for a frame's channels
+     * are adjacent; so a slice of one channel of stereo data has channels = 1 and stride = 2.
+     *
+     * A slice is only valid for as long as the data it points to. Read-only operations take
+     * slices; when the data needs to be changed, materialize it with pcm_slice_copy() first.
+     */
+    typedef struct _PCM_SLICE {
+        const pcm_sample_t *data; /* First sample of the first frame */
+        pcm_size_t size; /* Number of frames (samples per channel) */
+        int channels;
+        int stride; /* Number of samples from the start of one frame to the start of the next */
+        int resolution;
+        long rate;
+    } PCMSlice;
+
+    /* PCMRef is a handle to reference-counted PCM storage on the heap. Handles made with
+     * pcm_ref_share() point to the same PCMData until one of them asks to write with
+     * pcm_ref_write(), at which point that handle gets its own copy. So a clone that's never
+     * modified never costs a copy. Reference counts are not atomic, so handles to the same
+     * storage should stay on one thread.
+     */
+    typedef struct _PCM_STORE {
+        int refs; /* Number of PCMRef handles using this storage */
+        PCMData pcm;
+    } PCMStore;
+
+    typedef struct _PCM_REF {
+        PCMStore *store;
+    } PCMRef;
+
     typedef struct _WAV_META {
-        pcm_size_t data_start;
-        pcm_size_t data_end;
-        pcm_size_t samples;
+        pcm_offset_t data_start;
+        pcm_offset_t data_end;
+        pcm_offset_t samples;
         int channels;
         int resolution;
+        long rate;
     } WAVMeta;
 
     /* Function declarations */
@@ -87,6 +173,19 @@
     PCMData pcm_morph(PCMData *low, PCMData *high, float scale);
     PCMData pcm_gen_saw();
     PCMData pcm_gen_square();
+    PCMSlice pcm_slice(PCMData *pcm, pcm_index_t start, pcm_size_t size);
+    PCMSlice pcm_slice_of(PCMData *pcm);
+    PCMSlice pcm_slice_channel(PCMSlice slice, int channel);
+    PCMSlice pcm_slice_trim(PCMSlice slice, pcm_index_t start, pcm_size_t size);
+    pcm_sample_t pcm_slice_peak(PCMSlice slice);
+    PCMData pcm_slice_copy(PCMSlice slice);
+    PCMData pcm_slice_morph(PCMSlice start, PCMSlice end, float scale);
+    PCMRef pcm_ref_new(PCMData *pcm);
+    PCMRef pcm_ref_share(PCMRef ref);
+    const PCMData *pcm_ref_read(PCMRef ref);
+    PCMSlice pcm_ref_slice(PCMRef ref);
+    PCMData *pcm_ref_write(PCMRef *ref);
+    void pcm_ref_release(PCMRef *ref);
 
     /* Sets initial data for a PCMData struct */
     PCMData new_PCMData()
@@ -95,17 +194,42 @@
         pcm.resolution = 16;
         pcm.channels = 1;
         pcm.size = 0;
+        pcm.rate = PCM_PROC_DEFAULT_RATE;
         return pcm;
     }
 
-    /* Parses a WAV file header to get the data, size, resolution, and number of channels */
+    /* Returns the little-endian value of bytes bytes of data, starting at index start */
+    pcm_offset_t _wav_value(pcm_sample_t data[], pcm_index_t start, int bytes)
+    {
+        pcm_offset_t value = 0;
+        int bn;
+        for (bn = bytes - 1; bn >= 0; bn--) value = (value << 8) | (data[start + bn] & 0xff);
+        return value;
+    }
+
+    /* Parses a WAV file header to get the data, size, resolution, sample rate, and number of channels.
+     *
+     * RIFF, RF64, and Sony Wave64 files are supported. An RF64 file's data chunk has a placeholder
+     * size, and the real (64-bit) size is in its ds64 chunk. A Wave64 file's chunks have GUIDs
+     * and 64-bit sizes; but each GUID starts with the same four characters as the RIFF chunk ID,
+     * so the chunks are found the same way.
+     */
     WAVMeta get_wav_meta(pcm_size_t size, pcm_sample_t data[])
     {
         WAVMeta meta;
         if (size > 44) {
+            int rf64 = (data[0] == 'R' && data[1] == 'F' && data[2] == '6' && data[3] == '4');
+            int w64 = (data[0] == 'r' && data[1] == 'i' && data[2] == 'f' && data[3] == 'f');
+            pcm_index_t extra = w64 ? WAV_W64_HEADER_EXTRA : 0; /* Extra header bytes after a chunk ID */
+
             /* Get selected metadata (number of channels and resolution) from a WAV file */
             int channels = 0;
             int resolution = 0;
+            long rate = 0;
+
+            char xcid[] = "ds64"; /* RF64 size chunk ID */
+            int xcx = 0;
+            pcm_offset_t ds64_size = 0; /* Data size from the ds64 chunk */
 
             char dcid[] = "data"; /* Data chunk ID */
             int dcx = 0;
@@ -125,23 +249,46 @@
                 if (b == fcid[fcx] && channels == 0) {
                     if (fcx == 3) {
                         /* This index i is the end of the format chunk identifier. */
-                        if (i + WAV_CHANNEL_OFFSET < size) channels = data[i + WAV_CHANNEL_OFFSET];
-                        if (i + WAV_RESOLUTION_OFFSET < size) resolution = data[i + WAV_RESOLUTION_OFFSET];
+                        pcm_index_t fx = i + extra; /* Format fields are relative to this */
+                        if (fx + WAV_CHANNEL_OFFSET < size) channels = data[fx + WAV_CHANNEL_OFFSET];
+                        if (fx + WAV_RATE_OFFSET + 3 < size) rate = (long) _wav_value(data, fx + WAV_RATE_OFFSET, 4);
+                        if (fx + WAV_RESOLUTION_OFFSET < size) resolution = data[fx + WAV_RESOLUTION_OFFSET];
                     }
                     fcx++;
                 } else {
                     fcx = 0; /* The byte didn't match the next character in the chunk ID, so reset */
                 }
                
+                /* In an RF64 file, find the "ds64" chunk and get the real size of the data */
+                if (rf64 && b == xcid[xcx] && ds64_size == 0) {
+                    if (xcx == 3 && i + WAV_DS64_DATA_OFFSET + 8 <= size) {
+                        ds64_size = _wav_value(data, i + WAV_DS64_DATA_OFFSET, 8);
+                    }
+                    xcx++;
+                } else {
+                    xcx = 0;
+                }
+
                 /* Find the "data" chunk and determine the beginning and end of the PCM data */
                 if (b == dcid[dcx] && d_end == 0) {
                     if (dcx == 3) {
                         /* This index i is the end of the data chunk identifier. The data begins
                          * at this index + 5. The size is a 32-bit value in the four bytes from
                          * i+1 to i+4.
+                         *
+                         * In a Wave64 file, the rest of the GUID and a 64-bit size (which counts
+                         * the 24-byte chunk header) come first. In an RF64 file, a size of
+                         * 0xffffffff means that the size is in the ds64 chunk.
                          */
-                        d_st = i + 5;
-                        d_end = d_st + data[i+1] + (data[i+2] << 8) + (data[i+3] << 16) + (data[i+4] << 24);
+                        if (w64 && i + extra + 4 < size) {
+                            d_st = i + extra + 5;
+                            d_end = d_st + _wav_value(data, i + 13, 8) - WAV_W64_HEADER_SIZE;
+                        } else if (i + 4 < size) {
+                            d_st = i + 5;
+                            d_end = _wav_value(data, i + 1, 4);
+                            if (rf64 && d_end == 0xffffffffULL) d_end = ds64_size;
+                            d_end += d_st;
+                        }
                     }
                     dcx++;
                 } else {
@@ -156,6 +303,7 @@
             meta.data_end = d_end;
             meta.channels = channels;
             meta.resolution = resolution;
+            meta.rate = rate ? rate : PCM_PROC_DEFAULT_RATE;
             meta.samples = (d_end - d_st) / (resolution / 8);
         }
 
@@ -173,7 +321,7 @@
     {
         pcm_sample_t pcm_data[PCM_PROC_MAX];
         pcm_index_t ix = 0; // Index within new PCM data
-        pcm_index_t dx = meta.data_start + (start * (meta.resolution / 8)); // Index within WAV data
+        pcm_index_t dx = meta.data_start + (start * meta.channels * (meta.resolution / 8)); // Index within WAV data
         int i;
         for (i = 0; i < samples; i++)
         {
@@ -196,6 +344,7 @@
         PCMData pcm = new_PCMData();
         pcm_change_resolution(&pcm, meta.resolution);
         pcm.channels = meta.channels;
+        pcm.rate = meta.rate;
         set_pcm_data(&pcm, ix, pcm_data);
         return pcm;
     }
@@ -336,13 +485,8 @@
         int max = ((0x01 << pcm->resolution) / 2) - 1; /* Largest sample value based on resolution */
        
         /* Locate the peak sample in the PCM, among all channels. */
-        int peak = 0;
+        int peak = pcm_slice_peak(pcm_slice_of(pcm));
         pcm_index_t i;
-        for (i = 0; i < (pcm->size * pcm->channels); i++)
-        {
-            int pos_sample = abs(pcm->data[i]);
-            if (pos_sample > peak) peak = pos_sample;
-        }
        
         /* Calculate the coeffecient required to get the peak to the specified amplitude */
         float coeff = peak ? (max * new_amplitude) / peak  : 1;
@@ -364,28 +508,7 @@
      */
     PCMData pcm_from_channel(PCMData *pcm, int channel)
     {
-        if (channel > (pcm->channels - 1) || channel < 0) channel = PCM_PROC_CHANNEL_LEFT;
-
-        pcm_sample_t data[PCM_PROC_MAX];
-        pcm_index_t ic; /* Index within selected channel's PCM data */
-        for (ic = 0; ic < pcm->size; ic++)
-        {
-            int ch;
-            for (ch = 0; ch < pcm->channels; ch++)
-            {
-                if (ch == channel) {
-                    /* Get the sample for only the specfied channel */
-                    data[ic] = pcm->data[ic * pcm->channels + ch];
-                    break;
-                }
-            }
-        }
-       
-        PCMData converted = new_PCMData();
-        converted.resolution = pcm->resolution;
-        set_pcm_data(&converted, pcm->size, data);
-       
-        return converted;
+        return pcm_slice_copy(pcm_slice_channel(pcm_slice_of(pcm), channel));
     }
 
     /*
@@ -394,33 +517,14 @@
      */
     PCMData pcm_trim(PCMData *pcm, pcm_index_t start, pcm_size_t size)
     {
-        PCMData trimmed = new_PCMData();
-       
-        if (pcm->size >= (start + size)) {
-            pcm_sample_t data[PCM_PROC_MAX];
-            pcm_index_t offset = start * pcm->channels;
-           
-            pcm_index_t i;
-            pcm_index_t new_ix = 0; /* Index within the new PCM */
-            for (i = 0; i < (size * pcm->channels); i++) data[new_ix++] = pcm->data[i + offset];
-           
-            trimmed.channels = pcm->channels;
-            trimmed.resolution = pcm->resolution;
-            set_pcm_data(&trimmed, size * pcm->channels, data);
-        }
-       
-        return trimmed;
+        if (pcm->size < (start + size)) return new_PCMData();
+        return pcm_slice_copy(pcm_slice(pcm, start, size));
     }
 
     /* Returns a clone of a PCMData, passed by reference. */
     PCMData pcm_clone(PCMData *pcm)
     {
-        PCMData clone = new_PCMData();
-        clone.size = pcm->size;
-        clone.resolution = pcm->resolution;
-        clone.channels = pcm->channels;
-        set_pcm_data(&clone, pcm->size * pcm->channels, pcm->data);
-        return clone;
+        return pcm_slice_copy(pcm_slice_of(pcm));
     }
 
     /*
@@ -440,19 +544,7 @@
      */
     PCMData pcm_morph(PCMData *start, PCMData *end, float scale)
     {
-        PCMData morphed = new_PCMData();
-
-        pcm_sample_t pcm_data[PCM_PROC_MAX];
-        pcm_index_t i;
-        for (i = 0; i < start->size; i++)
-        {
-            float diff = end->data[i] - start->data[i]; /* PCM steps from start to end points */
-            float v = start->data[i] + (diff * scale);
-            pcm_data[i] = (pcm_sample_t) v; /* Cast to sample and set data point */
-        }
-        set_pcm_data(&morphed, start->size, pcm_data);
-
-        return morphed;
+        return pcm_slice_morph(pcm_slice_of(start), pcm_slice_of(end), scale);
     }
 
     PCMData pcm_gen_saw()
@@ -489,6 +581,205 @@
         return saw;
     }
 
+    /*
+     * Returns a PCMSlice view of size frames of the PCMData passed by reference, starting at
+     * frame start. Nothing is copied. If the range is out-of-bounds, the slice is empty.
+     */
+    PCMSlice pcm_slice(PCMData *pcm, pcm_index_t start, pcm_size_t size)
+    {
+        PCMSlice slice;
+        slice.data = pcm->data;
+        slice.size = 0;
+        slice.channels = pcm->channels;
+        slice.stride = pcm->channels;
+        slice.resolution = pcm->resolution;
+        slice.rate = pcm->rate;
+        if (pcm->size >= (start + size)) {
+            slice.data = pcm->data + (start * pcm->channels);
+            slice.size = size;
+        }
+        return slice;
+    }
+
+    /* Returns a PCMSlice view of all of the data in the PCMData passed by reference. */
+    PCMSlice pcm_slice_of(PCMData *pcm)
+    {
+        return pcm_slice(pcm, 0, pcm->size);
+    }
+
+    /*
+     * Narrows a PCMSlice to a single channel. As with pcm_from_channel(), if the channel
+     * provided is out-of-range, the left channel (channel 0) is used.
+     */
+    PCMSlice pcm_slice_channel(PCMSlice slice, int channel)
+    {
+        if (channel > (slice.channels - 1) || channel < 0) channel = PCM_PROC_CHANNEL_LEFT;
+        slice.data += channel;
+        slice.channels = 1;
+        return slice;
+    }
+
+    /* Narrows a PCMSlice to size frames, starting at frame start. Out-of-range gives an empty slice. */
+    PCMSlice pcm_slice_trim(PCMSlice slice, pcm_index_t start, pcm_size_t size)
+    {
+        if (slice.size < (start + size)) {
+            slice.size = 0;
+        } else {
+            slice.data += start * slice.stride;
+            slice.size = size;
+        }
+        return slice;
+    }
+
+    /* Returns the largest absolute sample value in a PCMSlice, among all channels. */
+    pcm_sample_t pcm_slice_peak(PCMSlice slice)
+    {
+        pcm_sample_t peak = 0;
+        pcm_index_t i;
+        for (i = 0; i < slice.size; i++)
+        {
+            const pcm_sample_t *frame = slice.data + (i * slice.stride);
+            int ch;
+            for (ch = 0; ch < slice.channels; ch++)
+            {
+                pcm_sample_t pos_sample = abs(frame[ch]);
+                if (pos_sample > peak) peak = pos_sample;
+            }
+        }
+        return peak;
+    }
+
+    /*
+     * Copies the data in a PCMSlice into a new PCMData, which may then be modified. Frames are
+     * written straight into the new PCMData, so there's no intermediate data array.
+     */
+    PCMData pcm_slice_copy(PCMSlice slice)
+    {
+        PCMData pcm = new_PCMData();
+        pcm.channels = slice.channels;
+        pcm.resolution = slice.resolution;
+        pcm.rate = slice.rate;
+
+        pcm_index_t ix = 0; /* Index within new PCM data */
+        pcm_index_t i;
+        for (i = 0; i < slice.size; i++)
+        {
+            const pcm_sample_t *frame = slice.data + (i * slice.stride);
+            int ch;
+            for (ch = 0; ch < slice.channels; ch++) pcm.data[ix++] = frame[ch];
+        }
+        pcm.size = slice.size;
+        return pcm;
+    }
+
+    /* Returns a PCM waveform that is a partial morph between the start PCMSlice and the end
+     * PCMSlice, at the specified scale from >0 to <1. The end slice must be at least as long
+     * as the start slice.
+     */
+    PCMData pcm_slice_morph(PCMSlice start, PCMSlice end, float scale)
+    {
+        PCMData morphed = new_PCMData();
+        morphed.channels = start.channels;
+        morphed.rate = start.rate;
+
+        pcm_index_t ix = 0; /* Index within morphed PCM data */
+        pcm_index_t i;
+        for (i = 0; i < start.size; i++)
+        {
+            const pcm_sample_t *s = start.data + (i * start.stride);
+            const pcm_sample_t *e = end.data + (i * end.stride);
+            int ch;
+            for (ch = 0; ch < start.channels; ch++)
+            {
+                float diff = e[ch] - s[ch]; /* PCM steps from start to end points */
+                float v = s[ch] + (diff * scale);
+                morphed.data[ix++] = (pcm_sample_t) v; /* Cast to sample and set data point */
+            }
+        }
+        morphed.size = start.size;
+
+        return morphed;
+    }
+
+    /*
+     * Copies the PCMData passed by reference into new shared storage, and returns the first
+     * reference to it. If the storage can't be allocated, the reference's store is NULL.
+     */
+    PCMRef pcm_ref_new(PCMData *pcm)
+    {
+        PCMRef ref;
+        ref.store = (PCMStore *) malloc(sizeof(PCMStore));
+        if (ref.store) {
+            ref.store->refs = 1;
+            ref.store->pcm.size = pcm->size;
+            ref.store->pcm.channels = pcm->channels;
+            ref.store->pcm.resolution = pcm->resolution;
+            ref.store->pcm.rate = pcm->rate;
+            pcm_index_t i;
+            for (i = 0; i < (pcm->size * pcm->channels); i++) ref.store->pcm.data[i] = pcm->data[i];
+        }
+        return ref;
+    }
+
+    /* Returns a new reference to the same storage. This is the copy-on-write clone; it's O(1). */
+    PCMRef pcm_ref_share(PCMRef ref)
+    {
+        if (ref.store) ref.store->refs++;
+        return ref;
+    }
+
+    /* Returns read-only access to the PCMData behind a reference, or NULL if the reference has
+     * no storage (its pcm_ref_new() failed, or it was released)
+     */
+    const PCMData *pcm_ref_read(PCMRef ref)
+    {
+        if (ref.store == NULL) return NULL;
+        return &ref.store->pcm;
+    }
+
+    /* Returns a PCMSlice view of all of the data behind a reference. A reference with no storage
+     * gives an empty slice, with NULL data and a size of 0.
+     */
+    PCMSlice pcm_ref_slice(PCMRef ref)
+    {
+        if (ref.store == NULL) {
+            PCMSlice empty;
+            empty.data = NULL;
+            empty.size = 0;
+            empty.channels = 1;
+            empty.stride = 1;
+            empty.resolution = 16;
+            empty.rate = PCM_PROC_DEFAULT_RATE;
+            return empty;
+        }
+        return pcm_slice_of(&ref.store->pcm);
+    }
+
+    /*
+     * Returns write access to the PCMData behind the reference passed by reference. If other
+     * references share the storage, this one is first given its own copy, so the others don't
+     * see the change. If that copy can't be allocated, or the reference has no storage, NULL is
+     * returned and the reference is left as it was.
+     */
+    PCMData *pcm_ref_write(PCMRef *ref)
+    {
+        if (ref->store == NULL) return NULL;
+        if (ref->store->refs > 1) {
+            PCMRef copy = pcm_ref_new(&ref->store->pcm);
+            if (copy.store == NULL) return NULL;
+            ref->store->refs--;
+            ref->store = copy.store;
+        }
+        return &ref->store->pcm;
+    }
+
+    /* Gives up a reference. The storage is freed when its last reference is released. */
+    void pcm_ref_release(PCMRef *ref)
+    {
+        if (ref->store && --ref->store->refs == 0) free(ref->store);
+        ref->store = NULL;
+    }
+
     #endif /* PCM_PROC_H_ */
 
 /*
@@ -0,0 +1,408 @@
+/* PCM Regions (pcm_regions.h)
+ *
+ * Automatic region selection for long recordings. Audio is analyzed in hops of
+ * PCM_REGIONS_HOP frames, and each hop is marked as silence, a transient (the attack after an
+ * onset), stable sustain, or other sound. Runs of hops with the same mark are merged into
+ * PCMRegions, which can be handed straight to wav_extract() or pcm_slice().
+ *
+ * Onsets are found from two cues: spectral flux (the increase in each FFT bin's magnitude from
+ * one hop to the next) against a running average, and a jump in the amplitude envelope from one
+ * hop to the next, which catches attacks that don't change the spectrum much. The detector is
+ * streaming: audio goes in one block at a time, so a recording of any length can be analyzed
+ * without holding it in memory.
+ *
+ * pcm_envelope() follows the amplitude envelope of a PCMSlice, with attack and release times. The
+ * detector follows the envelope of its input in the same way.
+ *
+ * pcm_regions_new() creates a PCMRegionDetector.
+ *
+ * pcm_regions_process() analyzes a block of interleaved PCM data.
+ *
+ * pcm_regions_finish() finishes the analysis and gives the list of regions.
+ *
+ * pcm_regions_free() frees a PCMRegionDetector.
+ *
+ * pcm_find_regions() analyzes a whole PCMSlice and gives the list of regions.
+ *
+ * If there isn't memory for every region, the analysis fails as a whole, rather than giving a
+ * list with regions missing: pcm_regions_process(), pcm_regions_finish(), and pcm_find_regions()
+ * return 0, and the list is empty.
+ *
+ * pcm_region_slice() returns a PCMSlice view of a region of a PCMData.
+ *
+ * pcm_region_list_free() frees the memory used by a region list.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_REGIONS_H_
+#include <math.h>
+#include <string.h>
+#include "pcm_proc.h"
+#include "pcm_fft.h"
+#define PCM_REGIONS_H_
+
+/* Analysis frame sizes */
+#define PCM_REGIONS_HOP 512
+#define PCM_REGIONS_WINDOW 1024
+
+/* Hops quieter than this (RMS, in dB below full scale) are silence */
+#define PCM_REGIONS_SILENCE_DB -50.0
+
+/* An onset is spectral flux this many times its running average */
+#define PCM_REGIONS_ONSET_RATIO 2.5
+
+/* Hops marked as transient after each onset (4 hops is about 46 ms at 44.1k) */
+#define PCM_REGIONS_TRANSIENT_HOPS 4
+
+/* An onset is also a hop whose envelope peak is this many times the last hop's (2 is 6 dB) */
+#define PCM_REGIONS_ENVELOPE_RATIO 2.0
+
+/* Attack and release times of the detector's envelope follower */
+#define PCM_REGIONS_ATTACK_MS 1.0
+#define PCM_REGIONS_RELEASE_MS 50.0
+
+/* Hops whose spectral flux, as a proportion of their spectrum, is below this are stable */
+#define PCM_REGIONS_STABLE_FLUX 0.08
+
+/* Region types */
+#define PCM_REGION_SILENCE 0
+#define PCM_REGION_TRANSIENT 1
+#define PCM_REGION_SUSTAIN 2
+#define PCM_REGION_SOUND 3
+
+/* A PCMRegion is a range of frames, and what kind of audio is in it */
+typedef struct _PCM_REGION {
+    pcm_offset_t start; /* First frame */
+    pcm_offset_t size; /* Number of frames */
+    int type; /* PCM_REGION_SILENCE, PCM_REGION_TRANSIENT, PCM_REGION_SUSTAIN, or PCM_REGION_SOUND */
+} PCMRegion;
+
+typedef struct _PCM_REGION_LIST {
+    PCMRegion *region;
+    pcm_size_t count;
+    pcm_size_t capacity;
+} PCMRegionList;
+
+/* PCMRegionDetector holds the state of one streaming analysis */
+typedef struct _PCM_REGION_DETECTOR {
+    int channels;
+    int resolution;
+    PCMFFT *fft;
+    float window[PCM_REGIONS_WINDOW]; /* The most recent mono samples, oldest first */
+    float hann[PCM_REGIONS_WINDOW];
+    float re[PCM_REGIONS_WINDOW];
+    float im[PCM_REGIONS_WINDOW];
+    float last_mag[PCM_REGIONS_WINDOW / 2 + 1]; /* Spectrum of the previous hop */
+    int fill; /* Frames in the current hop so far */
+    double hop_energy; /* Sum of squares in the current hop so far */
+    float flux_mean; /* Running average of spectral flux */
+    float attack; /* Envelope follower coefficients, from _pcm_envelope_coeff() */
+    float release;
+    float envelope; /* Envelope level, in sample units */
+    float envelope_peak; /* Highest envelope level in the current hop so far */
+    float last_envelope_peak; /* Highest envelope level in the previous hop */
+    int transient_left; /* Hops remaining in the current transient */
+    int failed; /* 1 if a region couldn't be added to the list */
+    pcm_offset_t position; /* Frame number of the start of the current hop */
+    PCMRegion current;
+    PCMRegionList list;
+} PCMRegionDetector;
+
+/* Function declarations */
+void pcm_envelope(PCMSlice src, float attack_ms, float release_ms, float env[]);
+PCMRegionDetector *pcm_regions_new(int channels, int resolution, long rate);
+int pcm_regions_process(PCMRegionDetector *det, const pcm_sample_t in[], pcm_size_t frames);
+int pcm_regions_finish(PCMRegionDetector *det, PCMRegionList *list);
+void pcm_regions_free(PCMRegionDetector *det);
+int pcm_find_regions(PCMSlice src, PCMRegionList *list);
+PCMSlice pcm_region_slice(PCMData *pcm, PCMRegion region);
+void pcm_region_list_free(PCMRegionList *list);
+
+/* Returns the one-pole coefficient for an envelope time in milliseconds. A time of 0 follows the
+ * peaks exactly.
+ */
+float _pcm_envelope_coeff(float ms, long rate)
+{
+    float r = (float) (rate ? rate : PCM_PROC_DEFAULT_RATE);
+    return (ms > 0) ? 1.0f - expf(-1000.0f / (ms * r)) : 1.0f;
+}
+
+/*
+ * Follows the amplitude envelope of a PCMSlice, and puts one envelope value per frame into
+ * env[]. The envelope rises toward the peak sample of each frame (among all channels) with the
+ * attack time, and falls with the release time. Values are in sample units.
+ */
+void pcm_envelope(PCMSlice src, float attack_ms, float release_ms, float env[])
+{
+    float attack = _pcm_envelope_coeff(attack_ms, src.rate);
+    float release = _pcm_envelope_coeff(release_ms, src.rate);
+    pcm_sample_t offset = (src.resolution == 8) ? 128 : 0;
+
+    float level = 0;
+    pcm_index_t i;
+    for (i = 0; i < src.size; i++)
+    {
+        const pcm_sample_t *frame = src.data + (i * src.stride);
+        float peak = 0;
+        int ch;
+        for (ch = 0; ch < src.channels; ch++)
+        {
+            float a = fabsf((float) (frame[ch] - offset));
+            if (a > peak) peak = a;
+        }
+        level += (peak - level) * ((peak > level) ? attack : release);
+        env[i] = level;
+    }
+}
+
+/* Creates a PCMRegionDetector for interleaved data at a sample rate (0 for the default rate),
+ * which sets the envelope follower's times. Returns NULL if there's no memory.
+ */
+PCMRegionDetector *pcm_regions_new(int channels, int resolution, long rate)
+{
+    PCMRegionDetector *det = (PCMRegionDetector *) calloc(1, sizeof(PCMRegionDetector));
+    if (det == NULL) return NULL;
+    det->fft = pcm_fft_new(PCM_REGIONS_WINDOW);
+    if (det->fft == NULL) {
+        free(det);
+        return NULL;
+    }
+    det->channels = channels;
+    det->resolution = resolution;
+    det->current.type = -1;
+    det->attack = _pcm_envelope_coeff(PCM_REGIONS_ATTACK_MS, rate);
+    det->release = _pcm_envelope_coeff(PCM_REGIONS_RELEASE_MS, rate);
+
+    int i;
+    for (i = 0; i < PCM_REGIONS_WINDOW; i++) det->hann[i] = 1.0f;
+    pcm_fft_hann(det->fft, det->hann);
+
+    return det;
+}
+
+/* Adds a region to the end of a region list, growing it as needed. Returns 1, or 0 if there's no
+ * memory, in which case the list is left as it was.
+ */
+int _pcm_region_add(PCMRegionList *list, PCMRegion region)
+{
+    if (list->count == list->capacity) {
+        pcm_size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        PCMRegion *grown = (PCMRegion *) realloc(list->region, sizeof(PCMRegion) * capacity);
+        if (grown == NULL) return 0;
+        list->region = grown;
+        list->capacity = capacity;
+    }
+    list->region[list->count++] = region;
+    return 1;
+}
+
+/* Marks one hop of size frames, extending the current region or starting a new one */
+void _pcm_regions_mark(PCMRegionDetector *det, pcm_size_t size, int type)
+{
+    if (det->current.type == type) {
+        det->current.size += size;
+    } else {
+        if (det->current.type >= 0 && !_pcm_region_add(&det->list, det->current)) det->failed = 1;
+        det->current.start = det->position;
+        det->current.size = size;
+        det->current.type = type;
+    }
+    det->position += size;
+}
+
+/* Analyzes a full hop, which is at the end of the window */
+void _pcm_regions_hop(PCMRegionDetector *det)
+{
+    /* Level of the hop, in dB below full scale */
+    double full_scale = (double) (1UL << (det->resolution - 1));
+    double rms = sqrt(det->hop_energy / PCM_REGIONS_HOP) / full_scale;
+    double db = (rms > 0) ? 20.0 * log10(rms) : -200.0;
+
+    /* Spectrum of the window, and its flux from the last hop */
+    int i;
+    for (i = 0; i < PCM_REGIONS_WINDOW; i++)
+    {
+        det->re[i] = det->window[i] * det->hann[i];
+        det->im[i] = 0;
+    }
+    pcm_fft_forward(det->fft, det->re, det->im);
+    float flux = 0;
+    float total = 0;
+    for (i = 0; i <= PCM_REGIONS_WINDOW / 2; i++)
+    {
+        float mag = sqrtf(det->re[i] * det->re[i] + det->im[i] * det->im[i]);
+        float rise = mag - det->last_mag[i];
+        if (rise > 0) flux += rise;
+        total += mag;
+        det->last_mag[i] = mag;
+    }
+
+    int type;
+    if (db < PCM_REGIONS_SILENCE_DB) {
+        type = PCM_REGION_SILENCE;
+        det->transient_left = 0;
+    } else {
+        int flux_onset = (flux > PCM_REGIONS_ONSET_RATIO * det->flux_mean);
+        int envelope_onset = (det->envelope_peak > PCM_REGIONS_ENVELOPE_RATIO * det->last_envelope_peak);
+        if (det->transient_left == 0 && (flux_onset || envelope_onset)) {
+            det->transient_left = PCM_REGIONS_TRANSIENT_HOPS;
+        }
+        if (det->transient_left) {
+            type = PCM_REGION_TRANSIENT;
+            det->transient_left--;
+        } else {
+            type = (flux < PCM_REGIONS_STABLE_FLUX * total) ? PCM_REGION_SUSTAIN : PCM_REGION_SOUND;
+        }
+    }
+    det->flux_mean += (flux - det->flux_mean) * 0.1f;
+    det->last_envelope_peak = det->envelope_peak;
+    det->envelope_peak = 0;
+    _pcm_regions_mark(det, PCM_REGIONS_HOP, type);
+
+    /* Slide the window along by a hop */
+    memmove(det->window, det->window + PCM_REGIONS_HOP, sizeof(float) * (PCM_REGIONS_WINDOW - PCM_REGIONS_HOP));
+    det->fill = 0;
+    det->hop_energy = 0;
+}
+
+/* Analyzes frames of interleaved PCM data. Blocks may be of any size. Returns 1, or 0 if there
+ * hasn't been memory for every region so far, in which case the analysis can be stopped.
+ */
+int pcm_regions_process(PCMRegionDetector *det, const pcm_sample_t in[], pcm_size_t frames)
+{
+    pcm_sample_t offset = (det->resolution == 8) ? 128 : 0;
+    float gain = 1.0f / det->channels;
+    float *hop = det->window + (PCM_REGIONS_WINDOW - PCM_REGIONS_HOP);
+    pcm_index_t i;
+    for (i = 0; i < frames; i++)
+    {
+        const pcm_sample_t *frame = in + (i * det->channels);
+        float v = 0;
+        float peak = 0;
+        int ch;
+        for (ch = 0; ch < det->channels; ch++)
+        {
+            float sample = (float) (frame[ch] - offset);
+            v += sample;
+            if (fabsf(sample) > peak) peak = fabsf(sample);
+        }
+        v *= gain;
+
+        /* Follow the envelope as pcm_envelope() does, keeping its peak for the hop */
+        det->envelope += (peak - det->envelope) * ((peak > det->envelope) ? det->attack : det->release);
+        if (det->envelope > det->envelope_peak) det->envelope_peak = det->envelope;
+
+        hop[det->fill++] = v;
+        det->hop_energy += v * v;
+        if (det->fill == PCM_REGIONS_HOP) _pcm_regions_hop(det);
+    }
+    return !det->failed;
+}
+
+/*
+ * Finishes the analysis. Any partial hop at the end goes to the last region. The region list is
+ * put into list, and then belongs to the caller (see pcm_region_list_free()). Returns 1, or 0 if
+ * there wasn't memory for every region, in which case list is empty.
+ */
+int pcm_regions_finish(PCMRegionDetector *det, PCMRegionList *list)
+{
+    if (det->fill) {
+        if (det->current.type < 0) det->current.type = PCM_REGION_SILENCE;
+        _pcm_regions_mark(det, det->fill, det->current.type);
+        det->fill = 0;
+    }
+    if (det->current.type >= 0 && !_pcm_region_add(&det->list, det->current)) det->failed = 1;
+    det->current.type = -1;
+    if (det->failed) pcm_region_list_free(&det->list);
+
+    *list = det->list;
+    det->list.region = NULL;
+    det->list.count = 0;
+    det->list.capacity = 0;
+    return !det->failed;
+}
+
+/* Frees a PCMRegionDetector, and any regions that weren't taken with pcm_regions_finish() */
+void pcm_regions_free(PCMRegionDetector *det)
+{
+    if (det == NULL) return;
+    pcm_fft_free(det->fft);
+    free(det->list.region);
+    free(det);
+}
+
+/*
+ * Analyzes a whole PCMSlice, and puts its region list into list. Region starts are relative to
+ * the start of the slice. Returns 1, or 0 if there's no memory, in which case list is empty.
+ *
+ * Example (take the longest stable region from a recording):
+ *
+ *   PCMRegionList regions;
+ *   if (!pcm_find_regions(pcm_slice_of(&recording), &regions)) return; // No memory
+ *   ...find the longest regions.region[i] whose type is PCM_REGION_SUSTAIN...
+ *   PCMSlice steady = pcm_region_slice(&recording, regions.region[longest]);
+ *   pcm_region_list_free(&regions);
+ */
+int pcm_find_regions(PCMSlice src, PCMRegionList *list)
+{
+    list->region = NULL;
+    list->count = 0;
+    list->capacity = 0;
+
+    PCMRegionDetector *det = pcm_regions_new(src.channels, src.resolution, src.rate);
+    if (det == NULL) return 0;
+
+    /* A slice whose stride doesn't match its channels is fed through one frame at a time */
+    if (src.stride == src.channels) {
+        pcm_regions_process(det, src.data, src.size);
+    } else {
+        pcm_index_t i;
+        for (i = 0; i < src.size && pcm_regions_process(det, src.data + (i * src.stride), 1); i++);
+    }
+    int ok = pcm_regions_finish(det, list);
+    pcm_regions_free(det);
+    return ok;
+}
+
+/* Returns a PCMSlice view of a region of the PCMData passed by reference. The slice is empty if
+ * the region isn't within the PCMData.
+ */
+PCMSlice pcm_region_slice(PCMData *pcm, PCMRegion region)
+{
+    if (region.start + region.size > pcm->size) return pcm_slice(pcm, 0, 0);
+    return pcm_slice(pcm, (pcm_index_t) region.start, (pcm_size_t) region.size);
+}
+
+/* Frees the memory used by a region list */
+void pcm_region_list_free(PCMRegionList *list)
+{
+    free(list->region);
+    list->region = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+#endif /* PCM_REGIONS_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
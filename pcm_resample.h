@@ -0,0 +1,356 @@
+/* PCM Resampler (pcm_resample.h)
+ *
+ * Sample rate conversion for PCM data. The converter is a streaming polyphase FIR filter. The
+ * ratio between the two rates is reduced to lowest terms (up/down), so 44100 -> 48000 runs as
+ * 160/147, and only the filter phases that land on an output sample are ever computed. Because
+ * it's streaming, a long file can be converted one block at a time, carrying the filter history
+ * from one block to the next.
+ *
+ * pcm_resampler_new() creates a PCMResampler for a pair of rates and a number of channels.
+ *
+ * pcm_resampler_process() converts a block of interleaved PCM data.
+ *
+ * pcm_resampler_flush() returns the last samples held in the filter, at the end of the input.
+ *
+ * pcm_resampler_free() frees a PCMResampler.
+ *
+ * pcm_change_rate() converts a whole PCMData to a new sample rate.
+ *
+ * pcm_resample_cycle() changes the length of one cycle of a periodic waveform.
+ *
+ * pcm_gcd() returns the greatest common divisor of two rates.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_RESAMPLE_H_
+#include <math.h>
+#include "pcm_proc.h"
+#define PCM_RESAMPLE_H_
+
+/* Taps per filter phase. More taps give a sharper cutoff at the cost of speed. */
+#define PCM_RESAMPLE_TAPS 32
+
+/* Filter cutoff, as a proportion of the lower of the two Nyquist frequencies */
+#define PCM_RESAMPLE_CUTOFF 0.91
+
+/* Kaiser window beta; about 80 dB of stopband attenuation */
+#define PCM_RESAMPLE_BETA 8.0
+
+/* The frames in one block of pcm_change_rate() */
+#define PCM_RESAMPLE_BLOCK 4096
+
+/* The most channels a PCMResampler will handle */
+#define PCM_RESAMPLE_MAX_CHANNELS 64
+
+/*
+ * PCMResampler holds the state of one streaming conversion. The filter history for each channel
+ * is kept twice over (at pos and pos + taps), so the most recent taps samples are always
+ * contiguous and can be run against a phase's coefficients without wrapping.
+ */
+typedef struct _PCM_RESAMPLER {
+    long up; /* Interpolation factor (to_rate / gcd) */
+    long down; /* Decimation factor (from_rate / gcd) */
+    int taps; /* Taps per phase */
+    int channels;
+    int resolution;
+    float *coeff; /* up phases of taps coefficients, each phase in oldest-to-newest order */
+    float *history; /* channels * (2 * taps) samples */
+    int pos; /* Position of the oldest sample in each channel's history */
+    long phase; /* Position of the next output sample, within the current input sample */
+    pcm_sample_t min; /* Output range, based on resolution */
+    pcm_sample_t max;
+} PCMResampler;
+
+/* Function declarations */
+PCMResampler *pcm_resampler_new(long from_rate, long to_rate, int channels, int resolution);
+pcm_size_t pcm_resampler_process(PCMResampler *rs, const pcm_sample_t in[], pcm_size_t frames, pcm_sample_t out[]);
+pcm_size_t pcm_resampler_flush(PCMResampler *rs, pcm_sample_t out[]);
+void pcm_resampler_free(PCMResampler *rs);
+void pcm_change_rate(PCMData *pcm, long new_rate);
+int pcm_resample_cycle(const pcm_sample_t in[], pcm_size_t in_size, pcm_sample_t out[], pcm_size_t out_size,
+                       int resolution);
+long pcm_gcd(long a, long b);
+
+/* Modified Bessel function of the first kind, for the Kaiser window */
+double _pcm_resample_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    int k;
+    for (k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Creates a resampler from from_rate to to_rate for interleaved data with the specified number
+ * of channels and resolution. Returns NULL if either rate is invalid, or if there's no memory.
+ *
+ * Example (44.1k -> 48k, stereo 16-bit, one block at a time):
+ *
+ *   PCMResampler *rs = pcm_resampler_new(44100, 48000, 2, 16);
+ *   pcm_size_t n = pcm_resampler_process(rs, block, block_frames, out);
+ *   ...
+ *   n = pcm_resampler_flush(rs, out);
+ *   pcm_resampler_free(rs);
+ */
+PCMResampler *pcm_resampler_new(long from_rate, long to_rate, int channels, int resolution)
+{
+    if (from_rate < 1 || to_rate < 1 || channels < 1 || channels > PCM_RESAMPLE_MAX_CHANNELS) return NULL;
+
+    PCMResampler *rs = (PCMResampler *) malloc(sizeof(PCMResampler));
+    if (rs == NULL) return NULL;
+
+    long gcd = pcm_gcd(from_rate, to_rate);
+    rs->up = to_rate / gcd;
+    rs->down = from_rate / gcd;
+    rs->taps = PCM_RESAMPLE_TAPS;
+    rs->channels = channels;
+    rs->resolution = resolution;
+    rs->pos = 0;
+    rs->coeff = (float *) malloc(sizeof(float) * rs->up * rs->taps);
+    rs->history = (float *) calloc(channels * 2 * rs->taps, sizeof(float));
+    if (rs->coeff == NULL || rs->history == NULL) {
+        pcm_resampler_free(rs);
+        return NULL;
+    }
+
+    /* 8-bit PCM is unsigned. Everything else is signed. */
+    if (resolution == 8) {
+        rs->min = 0;
+        rs->max = 0xff;
+    } else {
+        rs->max = (pcm_sample_t) ((1UL << (resolution - 1)) - 1);
+        rs->min = -1 - rs->max;
+    }
+
+    /* The history starts as silence, which for unsigned 8-bit PCM is 128 rather than 0 */
+    if (resolution == 8) {
+        long h;
+        for (h = 0; h < channels * 2 * rs->taps; h++) rs->history[h] = 128.0f;
+    }
+
+    /* Design the prototype low-pass filter at the upsampled rate. It's a Kaiser-windowed sinc,
+     * with its cutoff below whichever Nyquist frequency is lower, and a gain of up to make up for
+     * the zeros between upsampled samples. Then deal its coefficients out into phases.
+     */
+    long n = rs->up * rs->taps; /* Prototype filter length */
+    double center = (n - 1) / 2.0;
+    double fc = PCM_RESAMPLE_CUTOFF * 0.5 / (rs->up > rs->down ? rs->up : rs->down);
+    double i0_beta = _pcm_resample_i0(PCM_RESAMPLE_BETA);
+    long i;
+    for (i = 0; i < n; i++)
+    {
+        double t = i - center;
+        double sinc = (t == 0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        double r = t / center;
+        double window = _pcm_resample_i0(PCM_RESAMPLE_BETA * sqrt(r * r < 1.0 ? 1.0 - r * r : 0.0)) / i0_beta;
+
+        /* Coefficient i belongs to phase (i % up) at tap (i / up), counting back from the newest
+         * input sample. Store it in oldest-to-newest order to match the history.
+         */
+        long phase = i % rs->up;
+        long tap = i / rs->up;
+        rs->coeff[phase * rs->taps + (rs->taps - 1 - tap)] = (float) (sinc * window * rs->up);
+    }
+
+    /* Start at the filter's center, so that the output isn't delayed relative to the input */
+    rs->phase = (long) center;
+
+    return rs;
+}
+
+/*
+ * Converts frames of interleaved PCM data from in[], and puts the converted frames into out[].
+ * Returns the number of frames put into out[], which will be no more than
+ * (frames * up / down) + 1. Samples are clamped to the range of the resampler's resolution.
+ */
+pcm_size_t pcm_resampler_process(PCMResampler *rs, const pcm_sample_t in[], pcm_size_t frames, pcm_sample_t out[])
+{
+    pcm_index_t ox = 0; /* Index within output data */
+    int taps = rs->taps;
+    pcm_index_t i;
+    for (i = 0; i < frames; i++)
+    {
+        /* Add the input frame to each channel's history */
+        int ch;
+        for (ch = 0; ch < rs->channels; ch++)
+        {
+            float *h = rs->history + (ch * 2 * taps);
+            h[rs->pos] = h[rs->pos + taps] = (float) in[i * rs->channels + ch];
+        }
+        if (++rs->pos == taps) rs->pos = 0;
+
+        /* Compute every output sample that falls within this input sample */
+        while (rs->phase < rs->up)
+        {
+            const float *c = rs->coeff + (rs->phase * taps);
+            for (ch = 0; ch < rs->channels; ch++)
+            {
+                const float *h = rs->history + (ch * 2 * taps) + rs->pos;
+                float acc = 0;
+                int t;
+                for (t = 0; t < taps; t++) acc += c[t] * h[t];
+                pcm_sample_t sample = (pcm_sample_t) lrintf(acc);
+                if (sample > rs->max) sample = rs->max;
+                if (sample < rs->min) sample = rs->min;
+                out[ox++] = sample;
+            }
+            rs->phase += rs->down;
+        }
+        rs->phase -= rs->up;
+    }
+    return ox / rs->channels;
+}
+
+/*
+ * Runs silence through the resampler to push out the samples still in the filter. Returns the
+ * number of frames put into out[], which needs room for ((taps / 2) + 1) * ((up / down) + 1) frames.
+ */
+pcm_size_t pcm_resampler_flush(PCMResampler *rs, pcm_sample_t out[])
+{
+    pcm_sample_t silence[PCM_RESAMPLE_MAX_CHANNELS]; /* One frame of silence */
+    pcm_sample_t zero = (rs->resolution == 8) ? 128 : 0;
+    pcm_size_t frames = (rs->taps / 2) + 1;
+    pcm_index_t i;
+    for (i = 0; i < PCM_RESAMPLE_MAX_CHANNELS; i++) silence[i] = zero;
+
+    pcm_size_t size = 0;
+    for (i = 0; i < frames; i++)
+    {
+        size += pcm_resampler_process(rs, silence, 1, out + (size * rs->channels));
+    }
+    return size;
+}
+
+/* Frees a PCMResampler */
+void pcm_resampler_free(PCMResampler *rs)
+{
+    if (rs == NULL) return;
+    free(rs->coeff);
+    free(rs->history);
+    free(rs);
+}
+
+/*
+ * Converts the PCMData passed by reference to a new sample rate. The data is run through a
+ * PCMResampler one block at a time. The length of the result is size * new_rate / rate,
+ * limited by PCM_PROC_MAX.
+ */
+void pcm_change_rate(PCMData *pcm, long new_rate)
+{
+    if (new_rate == pcm->rate || pcm->size == 0) return;
+
+    PCMResampler *rs = pcm_resampler_new(pcm->rate, new_rate, pcm->channels, pcm->resolution);
+    if (rs == NULL) return;
+
+    pcm_size_t target = (pcm_size_t) (((double) pcm->size * rs->up + rs->down - 1) / rs->down);
+    if (target > (pcm_size_t) (PCM_PROC_MAX / pcm->channels)) target = PCM_PROC_MAX / pcm->channels;
+
+    /* Room for every output frame, plus what one block or the flush might add beyond that */
+    pcm_size_t room = target + (PCM_RESAMPLE_BLOCK + rs->taps) * (rs->up / rs->down + 2);
+    pcm_sample_t *data = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * room * pcm->channels);
+    if (data == NULL) {
+        pcm_resampler_free(rs);
+        return;
+    }
+
+    pcm_size_t size = 0; /* Number of converted frames */
+    pcm_index_t i;
+    for (i = 0; i < pcm->size && size < target; i += PCM_RESAMPLE_BLOCK)
+    {
+        pcm_size_t frames = pcm->size - i;
+        if (frames > PCM_RESAMPLE_BLOCK) frames = PCM_RESAMPLE_BLOCK;
+        size += pcm_resampler_process(rs, pcm->data + (i * pcm->channels), frames, data + (size * pcm->channels));
+    }
+    if (size < target) size += pcm_resampler_flush(rs, data + (size * pcm->channels));
+    if (size > target) size = target;
+
+    for (i = 0; i < size * pcm->channels; i++) pcm->data[i] = data[i];
+    pcm->size = size;
+    pcm->rate = new_rate;
+
+    free(data);
+    pcm_resampler_free(rs);
+}
+
+/*
+ * Resamples one cycle of a periodic waveform, of in_size mono samples, to out_size samples in
+ * out[] (for example, a 2048-sample wavetable frame to the Pro 3's 1024). Since the waveform
+ * repeats, the cycle is run through a PCMResampler three times over, and the middle cycle of the
+ * output is kept, so the filter sees the end of the cycle before its start, and there's no edge
+ * at either end. Shortening the cycle removes the harmonics that won't fit, rather than
+ * aliasing them. When the filter has an even length, the result lags by half an input sample,
+ * which only turns the phase of the cycle a little. Returns 1, or 0 if there's no memory.
+ */
+int pcm_resample_cycle(const pcm_sample_t in[], pcm_size_t in_size, pcm_sample_t out[], pcm_size_t out_size,
+                       int resolution)
+{
+    if (in_size == out_size) {
+        pcm_index_t i;
+        for (i = 0; i < out_size; i++) out[i] = in[i];
+        return 1;
+    }
+
+    PCMResampler *rs = pcm_resampler_new((long) in_size, (long) out_size, 1, resolution);
+    if (rs == NULL) return 0;
+    pcm_sample_t *data = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * (3 * out_size + rs->taps * (rs->up / rs->down + 2)));
+    if (data == NULL) {
+        pcm_resampler_free(rs);
+        return 0;
+    }
+
+    /* The resampler's output isn't delayed, so output sample j lines up with input sample
+     * j * in_size / out_size, and the middle cycle starts at output sample out_size.
+     */
+    pcm_size_t size = 0;
+    int pass;
+    for (pass = 0; pass < 3; pass++) size += pcm_resampler_process(rs, in, in_size, data + size);
+    if (size < 2 * out_size) size += pcm_resampler_flush(rs, data + size);
+    pcm_index_t i;
+    for (i = 0; i < out_size; i++) out[i] = (out_size + i < size) ? data[out_size + i] : 0;
+
+    free(data);
+    pcm_resampler_free(rs);
+    return 1;
+}
+
+/* Returns the greatest common divisor of a and b, for reducing rate ratios */
+long pcm_gcd(long a, long b)
+{
+    while (b)
+    {
+        long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+#endif /* PCM_RESAMPLE_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
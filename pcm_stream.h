@@ -0,0 +1,573 @@
+/* PCM Stream (pcm_stream.h)
+ *
+ * Block-based reading of raw PCM streams (for example, audio piped from arecord), and a ring
+ * buffer that keeps the most recent audio so that it can be snapshotted while capture goes on.
+ *
+ * The ring has one writer (the capture thread) and any number of readers. The writer never
+ * waits: it always overwrites the oldest audio. A reader copies out the frames it wants and
+ * then checks whether the writer lapped it during the copy, trying again if it did. So
+ * there are no locks on either side.
+ *
+ * pcm_read_block() reads a block of raw little-endian PCM frames from a stream.
+ *
+ * pcm_ring_new() creates a PCMRing holding a number of frames.
+ *
+ * pcm_ring_write() adds frames to a PCMRing, overwriting the oldest frames.
+ *
+ * pcm_ring_snapshot() copies the most recent frames from a PCMRing.
+ *
+ * pcm_ring_free() frees a PCMRing.
+ *
+ * wav_stream_open() reads the header of a RIFF, RF64, or Wave64 file from a stream, leaving
+ *     it ready to read PCM data.
+ *
+ * wav_stream_read() reads a block of PCM frames from a WAVStream.
+ *
+ * wav_stream_seek() moves a WAVStream to a frame.
+ *
+ * wav_writer_open() writes the header of a WAV file to a stream, ready for PCM data.
+ *
+ * wav_writer_write() writes a block of PCM frames to a WAVWriter.
+ *
+ * wav_writer_close() finishes a WAV file, filling in the sizes in its header.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PCM_STREAM_H_
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "pcm_proc.h"
+#define PCM_STREAM_H_
+
+/* The frames in one block read from a stream */
+#define PCM_STREAM_BLOCK 4096
+
+/* The most channels in a stream */
+#define PCM_STREAM_MAX_CHANNELS 8
+
+/* WAV container formats */
+#define WAV_FORMAT_RIFF 0
+#define WAV_FORMAT_RF64 1
+#define WAV_FORMAT_W64 2
+
+/* WAV sample encodings, from the fmt chunk */
+#define WAV_ENCODING_PCM 1
+#define WAV_ENCODING_FLOAT 3
+#define WAV_ENCODING_EXTENSIBLE 0xfffe
+
+/*
+ * PCMRing is a single-writer ring buffer of interleaved PCM frames. written counts every frame
+ * ever written, so readers can tell which frames are still in the ring. claimed is moved ahead
+ * before the writer starts overwriting frames, so readers can tell whether any of the frames
+ * they copied were being overwritten at the time. capacity is a power of two, so a frame's
+ * position in the ring is just (frame number & mask).
+ */
+typedef struct _PCM_RING {
+    pcm_sample_t *data;
+    pcm_size_t capacity; /* Frames in the ring */
+    pcm_size_t mask; /* capacity - 1 */
+    int channels;
+    int resolution;
+    long rate;
+    _Atomic unsigned long long written; /* Total frames written */
+    _Atomic unsigned long long claimed; /* Total frames written, or being written */
+} PCMRing;
+
+/*
+ * WAVStream reads the PCM data in a WAV file from a stream, one block at a time, so that files
+ * of any length can be processed. All positions are 64-bit, so RF64 and Wave64 files over 4 GB
+ * work (on 32-bit systems, build with _FILE_OFFSET_BITS=64 for fseeko() and ftello()). The
+ * meta's data_start and data_end are byte offsets from the start of the stream.
+ *
+ * 32-bit float data is read as 32-bit signed PCM, with 1.0 at full scale. Wavetable files (for
+ * example, from Serum) often have a 'clm ' chunk giving the number of samples in each cycle,
+ * which is kept in cycle.
+ */
+typedef struct _WAV_STREAM {
+    FILE *file;
+    WAVMeta meta;
+    int format; /* WAV_FORMAT_RIFF, WAV_FORMAT_RF64, or WAV_FORMAT_W64 */
+    int frame_bytes; /* Bytes per frame, all channels */
+    pcm_offset_t frames; /* Frames in the data chunk */
+    pcm_offset_t position; /* Next frame to be read */
+    int encoding; /* WAV_ENCODING_PCM or WAV_ENCODING_FLOAT */
+    pcm_size_t cycle; /* Samples per cycle, from a 'clm ' chunk, or 0 if there isn't one */
+} WAVStream;
+
+/*
+ * WAVWriter writes PCM data to a stream as a WAV file, one block at a time. The sizes in the
+ * header aren't known until the end, so they're written as 0xffffffff (which most programs take
+ * to mean "until the end of the file"), and filled in by wav_writer_close() if the stream can
+ * seek.
+ */
+typedef struct _WAV_WRITER {
+    FILE *file;
+    int channels;
+    int resolution;
+    long rate;
+    pcm_offset_t frames; /* Frames written so far */
+    off_t start; /* Offset of the header in the stream, or -1 if the stream can't seek */
+} WAVWriter;
+
+/* Function declarations */
+pcm_size_t pcm_read_block(FILE *stream, pcm_sample_t out[], pcm_size_t frames, int channels, int resolution);
+PCMRing *pcm_ring_new(pcm_size_t frames, int channels, int resolution, long rate);
+void pcm_ring_write(PCMRing *ring, const pcm_sample_t data[], pcm_size_t frames);
+pcm_size_t pcm_ring_snapshot(PCMRing *ring, pcm_sample_t out[], pcm_size_t frames);
+void pcm_ring_free(PCMRing *ring);
+int wav_stream_open(WAVStream *ws, FILE *file);
+pcm_size_t wav_stream_read(WAVStream *ws, pcm_sample_t out[], pcm_size_t frames);
+int wav_stream_seek(WAVStream *ws, pcm_offset_t frame);
+int wav_writer_open(WAVWriter *ww, FILE *file, int channels, int resolution, long rate);
+int wav_writer_write(WAVWriter *ww, const pcm_sample_t data[], pcm_size_t frames);
+int wav_writer_close(WAVWriter *ww);
+
+/*
+ * Reads up to frames frames of raw PCM from a stream into out[], with one fread() per block
+ * rather than one getchar() per byte. Samples are little-endian. 8-bit samples are unsigned
+ * and stay that way, as elsewhere in pcm_proc; wider samples are signed, and are sign-extended.
+ * Returns the number of whole frames read, which is less than frames only at the end of the
+ * stream (or on an error).
+ */
+pcm_size_t pcm_read_block(FILE *stream, pcm_sample_t out[], pcm_size_t frames, int channels, int resolution)
+{
+    unsigned char bytes[PCM_STREAM_BLOCK * PCM_STREAM_MAX_CHANNELS * 4];
+    int width = resolution / 8; /* Bytes per sample */
+    if (width < 1 || width > 4 || channels < 1 || channels > PCM_STREAM_MAX_CHANNELS) return 0;
+    pcm_size_t frame_bytes = width * channels;
+
+    pcm_size_t total = 0; /* Frames read */
+    while (total < frames)
+    {
+        pcm_size_t want = frames - total;
+        if (want > PCM_STREAM_BLOCK) want = PCM_STREAM_BLOCK;
+
+        /* A pipe may return less than was asked for, so keep reading until there's a whole
+         * number of frames, or the stream ends.
+         */
+        pcm_size_t got = 0;
+        while (got < want * frame_bytes)
+        {
+            size_t n = fread(bytes + got, 1, want * frame_bytes - got, stream);
+            if (n == 0) break;
+            got += n;
+        }
+        pcm_size_t got_frames = got / frame_bytes;
+
+        pcm_index_t i;
+        pcm_sample_t *dst = out + (total * channels);
+        if (width == 2) {
+            /* 16-bit is the common case, so it gets its own straight-line loop */
+            for (i = 0; i < got_frames * channels; i++)
+            {
+                dst[i] = (int16_t) (bytes[2 * i] | (bytes[2 * i + 1] << 8));
+            }
+        } else {
+            for (i = 0; i < got_frames * channels; i++)
+            {
+                const unsigned char *b = bytes + (i * width);
+                unsigned long v = 0;
+                int bn;
+                for (bn = 0; bn < width; bn++) v |= (unsigned long) b[bn] << (bn * 8);
+                if (width > 1 && width < 4 && (v & (1UL << (resolution - 1)))) v |= ~0UL << resolution;
+                dst[i] = (pcm_sample_t) v;
+            }
+        }
+
+        total += got_frames;
+        if (got_frames < want) break;
+    }
+    return total;
+}
+
+/*
+ * Creates a PCMRing holding at least the specified number of frames. The capacity is rounded
+ * up to a power of two. Returns NULL if there's no memory.
+ */
+PCMRing *pcm_ring_new(pcm_size_t frames, int channels, int resolution, long rate)
+{
+    PCMRing *ring = (PCMRing *) malloc(sizeof(PCMRing));
+    if (ring == NULL) return NULL;
+
+    pcm_size_t capacity = 1;
+    while (capacity < frames) capacity <<= 1;
+    ring->data = (pcm_sample_t *) calloc(capacity * channels, sizeof(pcm_sample_t));
+    if (ring->data == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->channels = channels;
+    ring->resolution = resolution;
+    ring->rate = rate;
+    atomic_init(&ring->written, 0);
+    atomic_init(&ring->claimed, 0);
+    return ring;
+}
+
+/*
+ * Adds frames of interleaved data to the ring, overwriting the oldest frames. Only one thread
+ * may write to a ring. The new frames are published to readers after they're all in place.
+ */
+void pcm_ring_write(PCMRing *ring, const pcm_sample_t data[], pcm_size_t frames)
+{
+    unsigned long long start = atomic_load_explicit(&ring->written, memory_order_relaxed);
+    atomic_store_explicit(&ring->claimed, start + frames, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    pcm_index_t i;
+    for (i = 0; i < frames; i++)
+    {
+        pcm_sample_t *dst = ring->data + (((start + i) & ring->mask) * ring->channels);
+        int ch;
+        for (ch = 0; ch < ring->channels; ch++) dst[ch] = data[i * ring->channels + ch];
+    }
+    atomic_store_explicit(&ring->written, start + frames, memory_order_release);
+}
+
+/*
+ * Copies the most recent frames from the ring into out[], oldest first. If fewer frames than
+ * that have been written, or the ring isn't that big, only those are copied. Returns the
+ * number of frames copied. This never blocks the writer.
+ */
+pcm_size_t pcm_ring_snapshot(PCMRing *ring, pcm_sample_t out[], pcm_size_t frames)
+{
+    if (frames > ring->capacity) frames = ring->capacity;
+    for (;;)
+    {
+        unsigned long long end = atomic_load_explicit(&ring->written, memory_order_acquire);
+        if (frames > end) frames = (pcm_size_t) end;
+        unsigned long long start = end - frames;
+
+        pcm_index_t i;
+        for (i = 0; i < frames; i++)
+        {
+            const pcm_sample_t *src = ring->data + (((start + i) & ring->mask) * ring->channels);
+            int ch;
+            for (ch = 0; ch < ring->channels; ch++) out[i * ring->channels + ch] = src[ch];
+        }
+
+        /* If the writer got all the way around to the start of the copy while it was going on,
+         * part of the copy may be newer audio, so do it again.
+         */
+        atomic_thread_fence(memory_order_acquire);
+        unsigned long long now = atomic_load_explicit(&ring->claimed, memory_order_relaxed);
+        if (now - start <= ring->capacity) return frames;
+    }
+}
+
+/* Frees a PCMRing */
+void pcm_ring_free(PCMRing *ring)
+{
+    if (ring == NULL) return;
+    free(ring->data);
+    free(ring);
+}
+
+/* Returns the little-endian value of bytes bytes from b */
+pcm_offset_t _wav_stream_value(const unsigned char *b, int bytes)
+{
+    pcm_offset_t value = 0;
+    int bn;
+    for (bn = bytes - 1; bn >= 0; bn--) value = (value << 8) | b[bn];
+    return value;
+}
+
+/* Reads exactly size bytes into b (or discards them, if b is NULL). Returns 1 if they were all read. */
+int _wav_stream_get(WAVStream *ws, unsigned char *b, pcm_offset_t size, pcm_offset_t *pos)
+{
+    unsigned char discard[256];
+    while (size)
+    {
+        size_t want = (size > sizeof(discard)) ? sizeof(discard) : (size_t) size;
+        size_t n = fread(b ? b : discard, 1, want, ws->file);
+        *pos += n;
+        if (n < want) return 0;
+        if (b) b += n;
+        size -= n;
+    }
+    return 1;
+}
+
+/* Moves from pos to the byte offset next, seeking if the stream allows it, or reading otherwise */
+int _wav_stream_skip(WAVStream *ws, pcm_offset_t *pos, pcm_offset_t next)
+{
+    if (next < *pos) return 0;
+    if (fseeko(ws->file, (off_t) next, SEEK_SET) == 0) {
+        *pos = next;
+        return 1;
+    }
+    return _wav_stream_get(ws, NULL, next - *pos, pos);
+}
+
+/*
+ * Reads the header of a WAV file from the start of a stream into the WAVStream passed by
+ * reference, and leaves the stream at the start of the PCM data. Chunks are walked one at a
+ * time, using their sizes (so nothing is scanned); a seekable file is walked to the end, and
+ * then returned to the data. Returns 1 if the header is good, or 0 if it isn't, or if the file
+ * has more than PCM_STREAM_MAX_CHANNELS channels.
+ */
+int wav_stream_open(WAVStream *ws, FILE *file)
+{
+    /* The tail shared by the standard Wave64 chunk GUIDs, after the four-character ID. Chunks
+     * with other GUIDs (list, marker, summarylist, or a vendor's) are skipped by their sizes.
+     */
+    static const unsigned char w64_guid[] = {0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a};
+    static const unsigned char w64_other[] = {0, 0, 0, 0};
+
+    ws->file = file;
+    ws->format = WAV_FORMAT_RIFF;
+    ws->frames = 0;
+    ws->position = 0;
+    ws->meta.data_start = 0;
+    ws->meta.data_end = 0;
+    ws->meta.samples = 0;
+    ws->meta.channels = 0;
+    ws->meta.resolution = 0;
+    ws->meta.rate = PCM_PROC_DEFAULT_RATE;
+    ws->encoding = WAV_ENCODING_PCM;
+    ws->cycle = 0;
+
+    unsigned char h[40];
+    pcm_offset_t pos = 0; /* Byte offset in the stream */
+    if (!_wav_stream_get(ws, h, 12, &pos)) return 0;
+    if (!memcmp(h, "RIFF", 4) && !memcmp(h + 8, "WAVE", 4)) {
+        ws->format = WAV_FORMAT_RIFF;
+    } else if (!memcmp(h, "RF64", 4) && !memcmp(h + 8, "WAVE", 4)) {
+        ws->format = WAV_FORMAT_RF64;
+    } else if (!memcmp(h, "riff", 4)) {
+        /* Wave64 starts with the riff GUID, a 64-bit size, and the wave GUID */
+        ws->format = WAV_FORMAT_W64;
+        if (!_wav_stream_get(ws, h + 12, 28, &pos) || memcmp(h + 24, "wave", 4)) return 0;
+    } else {
+        return 0;
+    }
+
+    int w64 = (ws->format == WAV_FORMAT_W64);
+    int header_size = w64 ? 24 : 8;
+    pcm_offset_t ds64_size = 0; /* Data size from an RF64 file's ds64 chunk */
+    int found_data = 0;
+    for (;;)
+    {
+        if (!_wav_stream_get(ws, h, header_size, &pos)) break;
+        const unsigned char *id = h; /* Four-character chunk ID */
+        if (w64) {
+            if (_wav_stream_value(h + 16, 8) < 24) return 0;
+            if (memcmp(h + 4, w64_guid, 12)) id = w64_other;
+        }
+        pcm_offset_t body_start = pos;
+        pcm_offset_t body = w64 ? _wav_stream_value(h + 16, 8) - 24 : _wav_stream_value(h + 4, 4);
+        unsigned char b[28];
+
+        if (!memcmp(id, "ds64", 4) && ws->format == WAV_FORMAT_RF64) {
+            if (!_wav_stream_get(ws, b, 24, &pos)) return 0;
+            ds64_size = _wav_stream_value(b + 8, 8);
+        } else if (!memcmp(id, "fmt ", 4)) {
+            /* The extensible format keeps the real encoding at the start of its subformat GUID */
+            int fmt_size = (body >= 26) ? 26 : 16;
+            if (!_wav_stream_get(ws, b, fmt_size, &pos)) return 0;
+            ws->encoding = (int) _wav_stream_value(b, 2);
+            if (ws->encoding == WAV_ENCODING_EXTENSIBLE && fmt_size == 26) ws->encoding = (int) _wav_stream_value(b + 24, 2);
+            ws->meta.channels = (int) _wav_stream_value(b + 2, 2);
+            ws->meta.rate = (long) _wav_stream_value(b + 4, 4);
+            ws->meta.resolution = (int) _wav_stream_value(b + 14, 2);
+        } else if (!memcmp(id, "clm ", 4) && body >= 7) {
+            /* Serum's cycle length is four digits after "<!>" */
+            if (!_wav_stream_get(ws, b, 7, &pos)) return 0;
+            if (!memcmp(b, "<!>", 3)) {
+                int d;
+                for (d = 3; d < 7 && b[d] >= '0' && b[d] <= '9'; d++) ws->cycle = (ws->cycle * 10) + (b[d] - '0');
+            }
+        } else if (!memcmp(id, "data", 4)) {
+            if (ws->format == WAV_FORMAT_RF64 && body == 0xffffffffULL) body = ds64_size;
+            ws->meta.data_start = body_start;
+            ws->meta.data_end = body_start + body;
+            found_data = 1;
+
+            /* A stream that can't seek has to stop here, at the start of the data */
+            if (ftello(file) < 0) break;
+        }
+
+        /* Chunks are padded to even sizes (or, in Wave64, to multiples of eight) */
+        pcm_offset_t next = body_start + body;
+        if (w64) next = (next + 7) & ~7ULL;
+        else next += (body & 1);
+        if (!_wav_stream_skip(ws, &pos, next)) break;
+    }
+
+    if (!found_data || ws->meta.channels < 1 || ws->meta.resolution < 8) return 0;
+    if (ws->meta.channels > PCM_STREAM_MAX_CHANNELS) return 0;
+    if (ws->encoding == WAV_ENCODING_FLOAT && ws->meta.resolution != 32) return 0;
+    if (ws->encoding != WAV_ENCODING_FLOAT && ws->encoding != WAV_ENCODING_PCM) return 0;
+    if (pos != ws->meta.data_start && fseeko(file, (off_t) ws->meta.data_start, SEEK_SET)) return 0;
+
+    int width = ws->meta.resolution / 8;
+    ws->frame_bytes = width * ws->meta.channels;
+    ws->meta.samples = (ws->meta.data_end - ws->meta.data_start) / width;
+    ws->frames = (ws->meta.data_end - ws->meta.data_start) / ws->frame_bytes;
+    return 1;
+}
+
+/*
+ * Reads up to frames frames of PCM data from a WAVStream into out[]. Float data is turned into
+ * 32-bit PCM. Returns the number of frames read, which is 0 at the end of the data.
+ */
+pcm_size_t wav_stream_read(WAVStream *ws, pcm_sample_t out[], pcm_size_t frames)
+{
+    if (ws->position >= ws->frames) return 0;
+    if (frames > ws->frames - ws->position) frames = (pcm_size_t) (ws->frames - ws->position);
+    pcm_size_t got = pcm_read_block(ws->file, out, frames, ws->meta.channels, ws->meta.resolution);
+    ws->position += got;
+
+    if (ws->encoding == WAV_ENCODING_FLOAT) {
+        pcm_index_t i;
+        for (i = 0; i < got * ws->meta.channels; i++)
+        {
+            union {uint32_t u; float f;} v;
+            v.u = (uint32_t) out[i];
+            double scaled = v.f * 2147483648.0;
+            if (scaled != scaled) scaled = 0; /* NaN */
+            if (scaled > 2147483647.0) scaled = 2147483647.0;
+            if (scaled < -2147483648.0) scaled = -2147483648.0;
+            out[i] = (pcm_sample_t) scaled;
+        }
+    }
+    return got;
+}
+
+/* Moves a WAVStream to a frame, so that the next read starts there. Returns 1 on success. */
+int wav_stream_seek(WAVStream *ws, pcm_offset_t frame)
+{
+    if (frame > ws->frames) return 0;
+    if (fseeko(ws->file, (off_t) (ws->meta.data_start + frame * ws->frame_bytes), SEEK_SET)) return 0;
+    ws->position = frame;
+    return 1;
+}
+
+/* Puts the little-endian value into bytes bytes at b */
+void _wav_writer_value(unsigned char *b, pcm_offset_t value, int bytes)
+{
+    int bn;
+    for (bn = 0; bn < bytes; bn++) b[bn] = (unsigned char) (value >> (bn * 8));
+}
+
+/*
+ * Sets up the WAVWriter passed by reference, and writes a 44-byte RIFF WAV header to a stream.
+ * Resolutions of 8, 16, 24, and 32 bits are supported. Returns 1 on success, or 0 if the
+ * format isn't supported or the header couldn't be written.
+ */
+int wav_writer_open(WAVWriter *ww, FILE *file, int channels, int resolution, long rate)
+{
+    ww->file = file;
+    ww->channels = channels;
+    ww->resolution = resolution;
+    ww->rate = rate;
+    ww->frames = 0;
+    ww->start = ftello(file);
+    if (channels < 1 || channels > PCM_STREAM_MAX_CHANNELS || resolution < 8 || resolution > 32 || resolution % 8) {
+        return 0;
+    }
+
+    int frame_bytes = channels * (resolution / 8);
+    unsigned char h[44];
+    memcpy(h, "RIFF", 4);
+    _wav_writer_value(h + 4, 0xffffffffULL, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    _wav_writer_value(h + 16, 16, 4); /* fmt chunk size */
+    _wav_writer_value(h + 20, 1, 2); /* PCM */
+    _wav_writer_value(h + 22, channels, 2);
+    _wav_writer_value(h + 24, rate, 4);
+    _wav_writer_value(h + 28, (pcm_offset_t) rate * frame_bytes, 4); /* Bytes per second */
+    _wav_writer_value(h + 32, frame_bytes, 2);
+    _wav_writer_value(h + 34, resolution, 2);
+    memcpy(h + 36, "data", 4);
+    _wav_writer_value(h + 40, 0xffffffffULL, 4);
+    return fwrite(h, 1, sizeof(h), file) == sizeof(h);
+}
+
+/*
+ * Writes frames frames of interleaved PCM data to a WAVWriter, with one fwrite() per block.
+ * As in pcm_read_block(), 8-bit samples are unsigned, and wider samples are signed. Returns 1
+ * if all the frames were written.
+ */
+int wav_writer_write(WAVWriter *ww, const pcm_sample_t data[], pcm_size_t frames)
+{
+    unsigned char bytes[PCM_STREAM_BLOCK * PCM_STREAM_MAX_CHANNELS * 4];
+    int width = ww->resolution / 8;
+    pcm_size_t done = 0;
+    while (done < frames)
+    {
+        pcm_size_t block = frames - done;
+        if (block > PCM_STREAM_BLOCK) block = PCM_STREAM_BLOCK;
+        const pcm_sample_t *src = data + (done * ww->channels);
+        pcm_size_t samples = block * ww->channels;
+        pcm_index_t i;
+        if (width == 2) {
+            for (i = 0; i < samples; i++)
+            {
+                bytes[2 * i] = (unsigned char) (src[i] & 0xff);
+                bytes[2 * i + 1] = (unsigned char) ((src[i] >> 8) & 0xff);
+            }
+        } else {
+            for (i = 0; i < samples; i++) _wav_writer_value(bytes + (i * width), (pcm_offset_t) src[i], width);
+        }
+        if (fwrite(bytes, 1, samples * width, ww->file) != samples * width) return 0;
+        ww->frames += block;
+        done += block;
+    }
+    return 1;
+}
+
+/*
+ * Finishes a WAV file. If the stream can seek, the sizes in the header are filled in (or left
+ * as 0xffffffff, if the data is over 4 GB). Returns 1 on success, or 0 if the stream couldn't
+ * be flushed. A stream that can't seek isn't an error; its header just keeps its open sizes.
+ */
+int wav_writer_close(WAVWriter *ww)
+{
+    pcm_offset_t data_size = ww->frames * ww->channels * (ww->resolution / 8);
+    int ok = 1;
+    if (data_size & 1) ok = (fputc(0, ww->file) != EOF); /* Pad the data chunk to an even size */
+
+    off_t end = ftello(ww->file);
+    if (ww->start >= 0 && end >= 0 && data_size + 36 + (data_size & 1) <= 0xffffffffULL
+        && fseeko(ww->file, ww->start + 4, SEEK_SET) == 0) {
+        unsigned char b[4];
+        _wav_writer_value(b, data_size + 36 + (data_size & 1), 4);
+        ok = ok && fwrite(b, 1, 4, ww->file) == 4;
+        ok = ok && fseeko(ww->file, ww->start + 40, SEEK_SET) == 0;
+        _wav_writer_value(b, data_size, 4);
+        ok = ok && fwrite(b, 1, 4, ww->file) == 4;
+        ok = ok && fseeko(ww->file, end, SEEK_SET) == 0;
+    }
+    return (fflush(ww->file) == 0) && ok;
+}
+
+#endif /* PCM_STREAM_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -0,0 +1,263 @@
+/* Pro 3 Alias (pro3_alias.h)
+ *
+ * Measures how much aliasing there is in the smaller levels of a wavetable's waveforms: the 512,
+ * 256, and 128-sample levels that the Pro 3 plays for higher notes. A level of n samples can only
+ * hold harmonics below n / 2. Anything the full waveform has above that should be filtered out
+ * when the level is made; if it isn't, it folds back and lands on lower harmonics, where it's
+ * heard as inharmonic grit. (wavetable_mips() makes levels with pcm_change_size(), which keeps
+ * every other sample and doesn't filter, so it aliases whatever is above each level's Nyquist.)
+ *
+ * Each level is compared with its band-limited ideal: the full waveform's harmonics below n / 2,
+ * and nothing above. All 16 waveforms of each level are transformed in one batch. For each level,
+ * the report gives two figures, in dB relative to the energy of the ideal:
+ *
+ *   above, the energy the full waveform has above the level's Nyquist, which has to be removed
+ *   alias, the energy of the difference between the level and the ideal
+ *
+ * A waveform's score is its worst alias figure, and a table's score is its worst waveform's. Lower
+ * is better; a level that matches its ideal exactly scores PRO3_ALIAS_FLOOR.
+ *
+ * pro3_alias_new() creates a Pro3Alias analyzer.
+ *
+ * pro3_alias_analyze() measures a Wavetable's levels, as they'd be exported.
+ *
+ * pro3_alias_bank() measures every slot of a Pro3Bank that has waveforms set.
+ *
+ * pro3_alias_print() prints a Pro3AliasReport, table and waveform by waveform.
+ *
+ * pro3_alias_free() frees a Pro3Alias analyzer.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_ALIAS_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "pcm_fft.h"
+#include "pro3_wavetable.h"
+#include "pro3_bank.h"
+#define PRO3_ALIAS_H_
+
+/* The smaller levels measured: 512, 256, and 128 samples */
+#define PRO3_ALIAS_LEVELS 3
+
+/* The lowest figure reported, in dB, for a level with no error at all */
+#define PRO3_ALIAS_FLOOR -120.0f
+
+/* A Pro3Alias analyzer keeps the transform plans and buffers, so that they're made once for any
+ * number of tables
+ */
+typedef struct _PRO3_ALIAS {
+    PCMFFT *fft[PRO3_ALIAS_LEVELS + 1]; /* 1024, 512, 256, and 128 points */
+    float *re; /* All 16 waveforms at each level, level after level */
+    float *im;
+} Pro3Alias;
+
+/* The measurements of one table. Level l is 1024 >> (l + 1) samples. */
+typedef struct _PRO3_ALIAS_REPORT {
+    float above[PRO3_WAVES][PRO3_ALIAS_LEVELS]; /* dB above each level's Nyquist */
+    float alias[PRO3_WAVES][PRO3_ALIAS_LEVELS]; /* dB of difference from the ideal */
+    float score[PRO3_WAVES]; /* Worst alias figure of each waveform */
+    float worst; /* Worst score of the table */
+    int worst_wave;
+    float mean; /* Mean score of the waveforms */
+} Pro3AliasReport;
+
+/* Function declarations */
+Pro3Alias *pro3_alias_new();
+void pro3_alias_analyze(Pro3Alias *analyzer, Wavetable *table, Pro3AliasReport *report);
+int pro3_alias_bank(Pro3Alias *analyzer, Pro3Bank *bank, Pro3AliasReport reports[]);
+void pro3_alias_print(const Pro3AliasReport *report, const char *name, FILE *file);
+void pro3_alias_free(Pro3Alias *analyzer);
+
+/* Offset of level l (0 is the full waveform) in a Pro3Alias's buffers */
+#define _PRO3_ALIAS_OFFSET(l) (PRO3_WAVES * ((2 * PRO3_SAMPLE_SIZE) - ((2 * PRO3_SAMPLE_SIZE) >> (l))))
+
+/* Creates a Pro3Alias analyzer. Returns NULL if there's no memory. */
+Pro3Alias *pro3_alias_new()
+{
+    Pro3Alias *analyzer = (Pro3Alias *) malloc(sizeof(Pro3Alias));
+    if (analyzer == NULL) return NULL;
+    int l;
+    int ok = 1;
+    for (l = 0; l <= PRO3_ALIAS_LEVELS; l++)
+    {
+        analyzer->fft[l] = pcm_fft_new(PRO3_SAMPLE_SIZE >> l);
+        if (analyzer->fft[l] == NULL) ok = 0;
+    }
+    analyzer->re = (float *) malloc(sizeof(float) * _PRO3_ALIAS_OFFSET(PRO3_ALIAS_LEVELS + 1));
+    analyzer->im = (float *) malloc(sizeof(float) * _PRO3_ALIAS_OFFSET(PRO3_ALIAS_LEVELS + 1));
+    if (!ok || analyzer->re == NULL || analyzer->im == NULL) {
+        pro3_alias_free(analyzer);
+        return NULL;
+    }
+    return analyzer;
+}
+
+/* Returns 10 log10(energy / reference), from PRO3_ALIAS_FLOOR up. Energy with no reference at
+ * all is 0 dB.
+ */
+float _pro3_alias_db(double energy, double reference)
+{
+    if (energy <= 0) return PRO3_ALIAS_FLOOR;
+    if (reference <= 0) return 0;
+    float db = (float) (10.0 * log10(energy / reference));
+    return (db < PRO3_ALIAS_FLOOR) ? PRO3_ALIAS_FLOOR : db;
+}
+
+/*
+ * Measures the smaller levels of all 16 waveforms of a Wavetable, as wavetable_mips() has them
+ * (so, as wavetable_sysex() would export them, or as wavetable_sysex_load() read them).
+ *
+ * A sine at harmonic h has a DFT bin of size n / 2 times its amplitude, at n points, so the ideal
+ * for a level of n points is the full waveform's bins below n / 2, times n / 1024. Energies count
+ * each bin between DC and Nyquist twice, for its mirror image.
+ */
+void pro3_alias_analyze(Pro3Alias *analyzer, Wavetable *table, Pro3AliasReport *report)
+{
+    int k;
+    int l;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        const pcm_sample_t *level = wavetable_mips(table, k);
+        for (l = 0; l <= PRO3_ALIAS_LEVELS; l++)
+        {
+            PCMFFT *fft = analyzer->fft[l];
+            float *re = analyzer->re + _PRO3_ALIAS_OFFSET(l) + (k * fft->size);
+            float *im = analyzer->im + _PRO3_ALIAS_OFFSET(l) + (k * fft->size);
+            if (l == 0) {
+                pcm_fft_load(fft, table->ref[k], re, im);
+            } else {
+                pcm_fft_load(fft, level, re, im);
+                level += fft->size;
+            }
+        }
+    }
+    for (l = 0; l <= PRO3_ALIAS_LEVELS; l++)
+    {
+        pcm_fft_forward_batch(analyzer->fft[l], analyzer->re + _PRO3_ALIAS_OFFSET(l), analyzer->im + _PRO3_ALIAS_OFFSET(l),
+                              PRO3_WAVES);
+    }
+
+    report->worst = PRO3_ALIAS_FLOOR;
+    report->worst_wave = 0;
+    report->mean = 0;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        const float *fre = analyzer->re + (k * PRO3_SAMPLE_SIZE);
+        const float *fim = analyzer->im + (k * PRO3_SAMPLE_SIZE);
+        report->score[k] = PRO3_ALIAS_FLOOR;
+        for (l = 1; l <= PRO3_ALIAS_LEVELS; l++)
+        {
+            int n = PRO3_SAMPLE_SIZE >> l;
+            float scale = (float) n / PRO3_SAMPLE_SIZE;
+            const float *mre = analyzer->re + _PRO3_ALIAS_OFFSET(l) + (k * n);
+            const float *mim = analyzer->im + _PRO3_ALIAS_OFFSET(l) + (k * n);
+            double ideal = 0;
+            double error = 0;
+            double above = 0;
+            int h;
+            for (h = 0; h <= n / 2; h++)
+            {
+                float weight = (h == 0 || h == n / 2) ? 1.0f : 2.0f;
+                float ire = (h < n / 2) ? fre[h] * scale : 0;
+                float iim = (h < n / 2) ? fim[h] * scale : 0;
+                float dre = mre[h] - ire;
+                float dim = mim[h] - iim;
+                ideal += weight * ((ire * ire) + (iim * iim));
+                error += weight * ((dre * dre) + (dim * dim));
+            }
+            for (h = n / 2; h <= PRO3_SAMPLE_SIZE / 2; h++)
+            {
+                float weight = (h == PRO3_SAMPLE_SIZE / 2) ? 1.0f : 2.0f;
+                above += weight * ((fre[h] * fre[h]) + (fim[h] * fim[h])) * scale * scale;
+            }
+            report->above[k][l - 1] = _pro3_alias_db(above, ideal);
+            report->alias[k][l - 1] = _pro3_alias_db(error, ideal);
+            if (report->alias[k][l - 1] > report->score[k]) report->score[k] = report->alias[k][l - 1];
+        }
+        if (k == 0 || report->score[k] > report->worst) {
+            report->worst = report->score[k];
+            report->worst_wave = k;
+        }
+        report->mean += report->score[k] / PRO3_WAVES;
+    }
+}
+
+/* Measures every slot of a Pro3Bank that has any waveforms set, with the levels that export would
+ * make, and puts its report into reports[slot]. Returns the number of slots measured, or -1 if
+ * there's no memory.
+ */
+int pro3_alias_bank(Pro3Alias *analyzer, Pro3Bank *bank, Pro3AliasReport reports[])
+{
+    Wavetable *table = (Wavetable *) malloc(sizeof(Wavetable));
+    if (table == NULL) return -1;
+    int measured = 0;
+    int s;
+    for (s = 0; s < PRO3_BANK_SLOTS; s++)
+    {
+        if (bank->isset[s] == 0) continue;
+        pro3_bank_store(bank, s, table);
+        pro3_alias_analyze(analyzer, table, &reports[s]);
+        measured++;
+    }
+    free(table);
+    return measured;
+}
+
+/* Prints a report: the table's worst and mean scores, and then each waveform's score, and its
+ * alias and above figures at each level
+ */
+void pro3_alias_print(const Pro3AliasReport *report, const char *name, FILE *file)
+{
+    fprintf(file, "%s: worst %.1f dB (waveform %d), mean %.1f dB\n", name, report->worst, report->worst_wave + 1,
+            report->mean);
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        fprintf(file, "  %2d: %7.1f dB |", k + 1, report->score[k]);
+        int l;
+        for (l = 0; l < PRO3_ALIAS_LEVELS; l++)
+        {
+            fprintf(file, " %3d: alias %6.1f above %6.1f", PRO3_SAMPLE_SIZE >> (l + 1), report->alias[k][l],
+                    report->above[k][l]);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+/* Frees a Pro3Alias analyzer */
+void pro3_alias_free(Pro3Alias *analyzer)
+{
+    if (analyzer == NULL) return;
+    int l;
+    for (l = 0; l <= PRO3_ALIAS_LEVELS; l++) pcm_fft_free(analyzer->fft[l]);
+    free(analyzer->re);
+    free(analyzer->im);
+    free(analyzer);
+}
+
+#endif /* PRO3_ALIAS_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
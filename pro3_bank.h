@@ -0,0 +1,377 @@
+/* Pro 3 Bank (pro3_bank.h)
+ *
+ * A Pro3Bank holds all 32 Pro 3 user wavetables (33-64) in one block of memory. The samples are
+ * always 16-bit, so they're kept as int16_t, which is half the size of a Wavetable's samples:
+ * the whole bank is 1 MB, and fits in a large L2 cache. The samples are laid out slot by slot,
+ * then waveform by waveform, so bulk operations on the bank go straight through memory, and the
+ * block is aligned to a cache line.
+ *
+ * Each slot has two bitmaps, with one bit for each of its 16 waveforms. isset marks the waveforms
+ * that have been set, as Wavetable.isset does. dirty marks the waveforms that have changed since
+ * the slot was last exported.
+ *
+ * Slots are numbered 0-31 here. A slot's zero-indexed Pro 3 wavetable number is
+ * PRO3_BANK_FIRST + slot.
+ *
+ * pro3_bank_new() creates an empty Pro3Bank.
+ *
+ * pro3_bank_set_reference() inserts a PCM waveform into a slot, as set_reference() does.
+ *
+ * pro3_bank_set_name() sets the name of a slot.
+ *
+ * pro3_bank_load() copies a Wavetable into a slot.
+ *
+ * pro3_bank_store() copies a slot into a Wavetable.
+ *
+ * pro3_bank_fill() fills in the empty waveforms of every slot, as wavetable_fill() does.
+ *
+ * pro3_bank_normalize() normalizes the amplitude of every slot.
+ *
+ * pro3_bank_export() sends the slots to standard output as system exclusive.
+ *
+ * pro3_bank_write() builds the system exclusive for every slot on a pool of threads, and writes
+ *     it all to one file.
+ *
+ * pro3_bank_free() frees a Pro3Bank.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_BANK_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pro3_wavetable.h"
+#define PRO3_BANK_H_
+
+/* The first user wavetable (33), zero-indexed as the Pro 3 numbers them */
+#define PRO3_BANK_FIRST 32
+
+/* The number of user wavetables */
+#define PRO3_BANK_SLOTS 32
+
+/* The size of a cache line, to which the samples are aligned */
+#define PRO3_BANK_ALIGN 64
+
+/* Bitmap of all 16 waveforms in a slot */
+#define PRO3_BANK_ALL_WAVES 0xffff
+
+/* The stack size of each thread in pro3_bank_write(). Building a message takes a few MB. */
+#define PRO3_BANK_STACK (16 * 1024 * 1024)
+
+typedef struct _PRO3_BANK {
+    _Alignas(PRO3_BANK_ALIGN) int16_t ref[PRO3_BANK_SLOTS][PRO3_WAVES][PRO3_SAMPLE_SIZE];
+    uint16_t isset[PRO3_BANK_SLOTS]; /* Bit k is set if waveform k has been set */
+    uint16_t dirty[PRO3_BANK_SLOTS]; /* Bit k is set if waveform k has changed since export */
+    char name[PRO3_BANK_SLOTS][9];
+} Pro3Bank;
+
+/* The work shared by the threads in pro3_bank_write(). Each thread takes the next slot that
+ * hasn't been taken, and builds its message into that slot's part of sysex.
+ */
+typedef struct _PRO3_BANK_JOB {
+    Pro3Bank *bank;
+    unsigned char *sysex; /* PRO3_SYSEX_SIZE bytes for each slot */
+    unsigned long size[PRO3_BANK_SLOTS]; /* Size of each slot's message, or 0 if it's not sent */
+    atomic_int next; /* The next slot to take */
+    atomic_int failed; /* Set if a thread ran out of memory */
+} Pro3BankJob;
+
+/* Function declarations */
+Pro3Bank *pro3_bank_new();
+void pro3_bank_set_reference(Pro3Bank *bank, int slot, PCMData *reference, int num);
+void pro3_bank_set_name(Pro3Bank *bank, int slot, const char *name);
+void pro3_bank_load(Pro3Bank *bank, int slot, Wavetable *table);
+void pro3_bank_store(Pro3Bank *bank, int slot, Wavetable *table);
+void pro3_bank_fill(Pro3Bank *bank);
+void pro3_bank_normalize(Pro3Bank *bank, float new_amplitude);
+void pro3_bank_export(Pro3Bank *bank, int dirty_only);
+int pro3_bank_write(Pro3Bank *bank, FILE *file, int threads);
+void pro3_bank_free(Pro3Bank *bank);
+
+/* Creates an empty Pro3Bank, with every slot named "Bank nn". Returns NULL if there's no memory. */
+Pro3Bank *pro3_bank_new()
+{
+    Pro3Bank *bank = (Pro3Bank *) aligned_alloc(PRO3_BANK_ALIGN, sizeof(Pro3Bank));
+    if (bank == NULL) return NULL;
+    memset(bank, 0, sizeof(Pro3Bank));
+    int s;
+    for (s = 0; s < PRO3_BANK_SLOTS; s++) snprintf(bank->name[s], 9, "Bank %02d", PRO3_BANK_FIRST + s + 1);
+    return bank;
+}
+
+/* Insert a PCM waveform into waveform num of a slot. As with set_reference(), the waveform is
+ * changed to 16-bit, 1024 samples first, unless it's already that.
+ */
+void pro3_bank_set_reference(Pro3Bank *bank, int slot, PCMData *reference, int num)
+{
+    int16_t *ref = bank->ref[slot][num];
+    int i;
+    if (reference->size == PRO3_SAMPLE_SIZE && reference->resolution == 16) {
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) ref[i] = (int16_t) reference->data[i];
+    } else {
+        PCMData clone = pcm_clone(reference);
+        if (clone.size != PRO3_SAMPLE_SIZE) pcm_change_size(&clone, PRO3_SAMPLE_SIZE);
+        if (clone.resolution != 16) pcm_change_resolution(&clone, 16);
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) ref[i] = (int16_t) clone.data[i];
+    }
+    bank->isset[slot] |= 1 << num;
+    bank->dirty[slot] |= 1 << num;
+}
+
+/* Sets the name of a slot. Names longer than 8 characters are cut off. */
+void pro3_bank_set_name(Pro3Bank *bank, int slot, const char *name)
+{
+    strncpy(bank->name[slot], name, 8);
+    bank->name[slot][8] = '\0';
+}
+
+/* Copies every waveform of a Wavetable into a slot */
+void pro3_bank_load(Pro3Bank *bank, int slot, Wavetable *table)
+{
+    uint16_t isset = 0;
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) bank->ref[slot][k][i] = (int16_t) table->ref[k][i];
+        if (table->isset[k]) isset |= 1 << k;
+    }
+    bank->isset[slot] = isset;
+    bank->dirty[slot] = PRO3_BANK_ALL_WAVES;
+}
+
+/* Copies every waveform of a slot into a Wavetable */
+void pro3_bank_store(Pro3Bank *bank, int slot, Wavetable *table)
+{
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[k][i] = bank->ref[slot][k][i];
+        table->isset[k] = (bank->isset[slot] >> k) & 1;
+        wavetable_touch(table, k);
+    }
+}
+
+/* Fill in the empty waveforms of every slot by linear interpolation, with the same rules and
+ * results as wavetable_fill(). Slots without a first waveform are left alone.
+ */
+void pro3_bank_fill(Pro3Bank *bank)
+{
+    int s;
+    for (s = 0; s < PRO3_BANK_SLOTS; s++)
+    {
+        uint16_t isset = bank->isset[s];
+        if ((isset & 1) == 0) continue;
+        int16_t (*ref)[PRO3_SAMPLE_SIZE] = bank->ref[s];
+        uint16_t filled = 0;
+
+        /* If the last waveform isn't set, fill the last position with the first wave */
+        if ((isset & (1 << (PRO3_WAVES - 1))) == 0) {
+            memcpy(ref[PRO3_WAVES - 1], ref[0], sizeof(ref[0]));
+            filled |= 1 << (PRO3_WAVES - 1);
+            isset |= filled;
+        }
+
+        int c;
+        for (c = 1; c < PRO3_WAVES; c++) /* c = current index */
+        {
+            if ((isset >> c) & 1) continue;
+            int n;
+            for (n = c; ((isset >> n) & 1) == 0; n++); /* n = next set index */
+
+            int t;
+            for (t = c; t < n; t++) /* t = target index */
+            {
+                float scale = (float) (t - c + 1) / (n - c);
+                int i;
+                for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+                {
+                    float pcm_diff = ref[n][i] - ref[c-1][i];
+                    ref[t][i] = (int16_t) (ref[c-1][i] + (pcm_diff * scale));
+                }
+                filled |= 1 << t;
+            }
+        }
+
+        bank->isset[s] = PRO3_BANK_ALL_WAVES;
+        bank->dirty[s] |= filled;
+    }
+}
+
+/* Normalizes the amplitude of each slot to a proportion of full scale. The gain comes from the
+ * peak of all of the slot's set waveforms together, so the waveforms keep their levels relative
+ * to each other.
+ */
+void pro3_bank_normalize(Pro3Bank *bank, float new_amplitude)
+{
+    int s;
+    for (s = 0; s < PRO3_BANK_SLOTS; s++)
+    {
+        uint16_t isset = bank->isset[s];
+        int peak = 0;
+        int k, i;
+        for (k = 0; k < PRO3_WAVES; k++)
+        {
+            if (((isset >> k) & 1) == 0) continue;
+            for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+            {
+                int v = bank->ref[s][k][i];
+                if (v < 0) v = -v;
+                if (v > peak) peak = v;
+            }
+        }
+        if (peak == 0) continue;
+
+        float coeff = (32767 * new_amplitude) / peak;
+        for (k = 0; k < PRO3_WAVES; k++)
+        {
+            if (((isset >> k) & 1) == 0) continue;
+            int16_t *ref = bank->ref[s][k];
+            for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+            {
+                float v = ref[i] * coeff;
+                if (v > 32767) v = 32767;
+                if (v < -32768) v = -32768;
+                ref[i] = (int16_t) v;
+            }
+        }
+        bank->dirty[s] |= isset;
+    }
+}
+
+/* Sends each slot that has its first waveform set to standard output as system exclusive, in
+ * slot order. If dirty_only is nonzero, only slots with changes since they were last exported
+ * are sent. The slots that are sent are marked clean.
+ */
+void pro3_bank_export(Pro3Bank *bank, int dirty_only)
+{
+    static Wavetable table;
+    int s;
+    for (s = 0; s < PRO3_BANK_SLOTS; s++)
+    {
+        if ((bank->isset[s] & 1) == 0) continue;
+        if (dirty_only && bank->dirty[s] == 0) continue;
+
+        char name[9]; /* wavetable_sysex_dump() pads the name to 8 characters */
+        strcpy(name, bank->name[s]);
+        pro3_bank_store(bank, s, &table);
+        wavetable_sysex_dump(&table, PRO3_BANK_FIRST + s, name);
+        bank->dirty[s] = 0;
+    }
+}
+
+/* Builds messages for the slots of a Pro3BankJob until they've all been taken */
+void *_pro3_bank_worker(void *arg)
+{
+    Pro3BankJob *job = (Pro3BankJob *) arg;
+    Wavetable *table = (Wavetable *) malloc(sizeof(Wavetable));
+    if (table == NULL) {
+        atomic_store(&job->failed, 1);
+        return NULL;
+    }
+
+    int s;
+    while ((s = atomic_fetch_add(&job->next, 1)) < PRO3_BANK_SLOTS)
+    {
+        job->size[s] = 0;
+        if ((job->bank->isset[s] & 1) == 0) continue;
+        pro3_bank_store(job->bank, s, table);
+        job->size[s] = wavetable_sysex(table, PRO3_BANK_FIRST + s, job->bank->name[s],
+                                       job->sysex + ((unsigned long) s * PRO3_SYSEX_SIZE));
+    }
+
+    free(table);
+    return NULL;
+}
+
+/* Writes the system exclusive for each slot that has its first waveform set to a file, in slot
+ * order, as one .syx. The messages are built on the calling thread and threads - 1 more, and
+ * then written out in slot order once they're all done, so the file is the same whatever the
+ * number of threads. The slots that are written are marked clean.
+ *
+ * Returns the number of slots written, or -1 if there wasn't enough memory or the file couldn't
+ * be written.
+ */
+int pro3_bank_write(Pro3Bank *bank, FILE *file, int threads)
+{
+    if (threads < 1) threads = 1;
+    if (threads > PRO3_BANK_SLOTS) threads = PRO3_BANK_SLOTS;
+
+    Pro3BankJob *job = (Pro3BankJob *) malloc(sizeof(Pro3BankJob));
+    if (job == NULL) return -1;
+    job->bank = bank;
+    job->sysex = (unsigned char *) malloc((unsigned long) PRO3_SYSEX_SIZE * PRO3_BANK_SLOTS);
+    atomic_init(&job->next, 0);
+    atomic_init(&job->failed, 0);
+    if (job->sysex == NULL) {
+        free(job);
+        return -1;
+    }
+
+    /* If a thread can't be started, the threads that did start (and this one) take its share */
+    pthread_t pool[PRO3_BANK_SLOTS];
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PRO3_BANK_STACK);
+    int started = 0;
+    while (started < threads - 1 && pthread_create(&pool[started], &attr, _pro3_bank_worker, job) == 0) started++;
+    pthread_attr_destroy(&attr);
+    _pro3_bank_worker(job);
+    int t;
+    for (t = 0; t < started; t++) pthread_join(pool[t], NULL);
+
+    int written = 0;
+    if (atomic_load(&job->failed)) {
+        written = -1;
+    } else {
+        int s;
+        for (s = 0; s < PRO3_BANK_SLOTS; s++)
+        {
+            if (job->size[s] == 0) continue;
+            if (fwrite(job->sysex + ((unsigned long) s * PRO3_SYSEX_SIZE), 1, job->size[s], file) != job->size[s]) {
+                written = -1;
+                break;
+            }
+            bank->dirty[s] = 0;
+            written++;
+        }
+    }
+
+    free(job->sysex);
+    free(job);
+    return written;
+}
+
+/* Frees a Pro3Bank */
+void pro3_bank_free(Pro3Bank *bank)
+{
+    free(bank);
+}
+
+#endif /* PRO3_BANK_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -0,0 +1,299 @@
+/* Pro 3 Fingerprint (pro3_fingerprint.h)
+ *
+ * Finds wavetables that sound alike, for spotting near-duplicates in a library, or finding more
+ * tables like one that's wanted. Each table is summed up as a Pro3Fingerprint: for each of its 16
+ * waveforms, the level of 32 bands of harmonics, spaced about evenly in pitch from the first
+ * harmonic to the 511th. Levels are in decibels below the loudest band in the table, from 0 to
+ * PRO3_FINGERPRINT_RANGE dB, quantized to one byte, so the fingerprint doesn't depend on how loud
+ * the table is, or on the phases of its harmonics. A fingerprint is 512 bytes.
+ *
+ * Fingerprints are kept end to end in a Pro3Index, a flat block of memory aligned to a cache
+ * line. A query works out the distance (the sum of squared differences of the bytes) to every
+ * fingerprint in the index, in a loop with no branches that the compiler can vectorize, and keeps
+ * the nearest as it goes. An index of tens of thousands of tables is gone through in a few
+ * milliseconds. An index can be written to a file, and read back, as it is.
+ *
+ * pro3_fingerprint() makes the fingerprint of a Wavetable.
+ *
+ * pro3_fingerprint_distance() returns the distance between two fingerprints.
+ *
+ * pro3_index_new() creates an empty Pro3Index.
+ *
+ * pro3_index_add() adds a fingerprint to a Pro3Index.
+ *
+ * pro3_index_nearest() finds the fingerprints in a Pro3Index nearest to a fingerprint.
+ *
+ * pro3_index_write() and pro3_index_read() write a Pro3Index to a file, and read it back.
+ *
+ * pro3_index_free() frees a Pro3Index.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_FINGERPRINT_H_
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pcm_fft.h"
+#include "pro3_wavetable.h"
+#define PRO3_FINGERPRINT_H_
+
+/* Bands of harmonics in each waveform's part of a fingerprint */
+#define PRO3_FINGERPRINT_BANDS 32
+
+/* Levels more than this many dB below the loudest band are all 0 */
+#define PRO3_FINGERPRINT_RANGE 96.0f
+
+/* Fingerprints in an index are aligned to this many bytes */
+#define PRO3_FINGERPRINT_ALIGN 64
+
+/* The first 8 bytes of an index file */
+#define PRO3_INDEX_MAGIC "PRO3IDX"
+
+typedef struct _PRO3_FINGERPRINT {
+    _Alignas(PRO3_FINGERPRINT_ALIGN) unsigned char band[PRO3_WAVES][PRO3_FINGERPRINT_BANDS];
+} Pro3Fingerprint;
+
+/* A Pro3Index is count fingerprints, end to end. Each is found by its position, from 0. */
+typedef struct _PRO3_INDEX {
+    Pro3Fingerprint *fingerprint;
+    int count;
+    int capacity;
+} Pro3Index;
+
+/* Function declarations */
+int pro3_fingerprint(Wavetable *table, Pro3Fingerprint *fingerprint);
+uint32_t pro3_fingerprint_distance(const Pro3Fingerprint *a, const Pro3Fingerprint *b);
+Pro3Index *pro3_index_new();
+int pro3_index_add(Pro3Index *index, const Pro3Fingerprint *fingerprint);
+int pro3_index_nearest(const Pro3Index *index, const Pro3Fingerprint *query, int k, int position[],
+                       uint32_t distance[]);
+int pro3_index_write(const Pro3Index *index, FILE *file);
+Pro3Index *pro3_index_read(FILE *file);
+void pro3_index_free(Pro3Index *index);
+
+/* Returns the first harmonic of band b. Band b runs up to, but not including, the first harmonic
+ * of band b + 1, and the last band runs up to harmonic 511. Bands are spaced evenly in pitch, but
+ * each has at least one harmonic, so the lowest bands are one harmonic each.
+ */
+int _pro3_fingerprint_edge(int b)
+{
+    int edge = 1;
+    int i;
+    for (i = 1; i <= b; i++)
+    {
+        int next = (int) lrint(pow(PRO3_SAMPLE_SIZE / 2, (double) i / PRO3_FINGERPRINT_BANDS));
+        edge = (next > edge) ? next : edge + 1;
+    }
+    return edge;
+}
+
+/* Makes the fingerprint of a Wavetable, from all 16 of its waveforms, set or not. All 16 are
+ * transformed in one batch. Returns 1, or 0 if there's no memory.
+ */
+int pro3_fingerprint(Wavetable *table, Pro3Fingerprint *fingerprint)
+{
+    PCMFFT *fft = pcm_fft_new(PRO3_SAMPLE_SIZE);
+    float *re = (float *) malloc(sizeof(float) * PRO3_SAMPLE_SIZE * PRO3_WAVES);
+    float *im = (float *) malloc(sizeof(float) * PRO3_SAMPLE_SIZE * PRO3_WAVES);
+    if (fft == NULL || re == NULL || im == NULL) {
+        pcm_fft_free(fft);
+        free(re);
+        free(im);
+        return 0;
+    }
+
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        pcm_fft_load(fft, table->ref[k], re + (k * PRO3_SAMPLE_SIZE), im + (k * PRO3_SAMPLE_SIZE));
+    }
+    pcm_fft_forward_batch(fft, re, im, PRO3_WAVES);
+
+    int edge[PRO3_FINGERPRINT_BANDS + 1];
+    int b;
+    for (b = 0; b < PRO3_FINGERPRINT_BANDS; b++) edge[b] = _pro3_fingerprint_edge(b);
+    edge[PRO3_FINGERPRINT_BANDS] = PRO3_SAMPLE_SIZE / 2;
+
+    /* The power in each band, and the loudest band in the table */
+    float power[PRO3_WAVES][PRO3_FINGERPRINT_BANDS];
+    float loudest = 0;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        const float *wre = re + (k * PRO3_SAMPLE_SIZE);
+        const float *wim = im + (k * PRO3_SAMPLE_SIZE);
+        for (b = 0; b < PRO3_FINGERPRINT_BANDS; b++)
+        {
+            float sum = 0;
+            int h;
+            for (h = edge[b]; h < edge[b + 1]; h++) sum += (wre[h] * wre[h]) + (wim[h] * wim[h]);
+            power[k][b] = sum;
+            if (sum > loudest) loudest = sum;
+        }
+    }
+
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        for (b = 0; b < PRO3_FINGERPRINT_BANDS; b++)
+        {
+            float db = (power[k][b] > 0 && loudest > 0) ? 10.0f * log10f(power[k][b] / loudest) : -PRO3_FINGERPRINT_RANGE;
+            float q = (db + PRO3_FINGERPRINT_RANGE) * (255.0f / PRO3_FINGERPRINT_RANGE);
+            if (q < 0) q = 0;
+            if (q > 255) q = 255;
+            fingerprint->band[k][b] = (unsigned char) lrintf(q);
+        }
+    }
+
+    pcm_fft_free(fft);
+    free(re);
+    free(im);
+    return 1;
+}
+
+/* Returns the sum of the squared differences between the bytes of two fingerprints */
+uint32_t pro3_fingerprint_distance(const Pro3Fingerprint *a, const Pro3Fingerprint *b)
+{
+    const unsigned char *x = &a->band[0][0];
+    const unsigned char *y = &b->band[0][0];
+    uint32_t sum = 0;
+    int i;
+    for (i = 0; i < (int) sizeof(Pro3Fingerprint); i++)
+    {
+        int d = x[i] - y[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+/* Creates an empty Pro3Index. Returns NULL if there's no memory. */
+Pro3Index *pro3_index_new()
+{
+    Pro3Index *index = (Pro3Index *) malloc(sizeof(Pro3Index));
+    if (index == NULL) return NULL;
+    index->fingerprint = NULL;
+    index->count = 0;
+    index->capacity = 0;
+    return index;
+}
+
+/* Makes room for at least capacity fingerprints. Returns 1, or 0 if there's no memory. */
+int _pro3_index_reserve(Pro3Index *index, int capacity)
+{
+    if (capacity <= index->capacity) return 1;
+    int room = index->capacity ? index->capacity : 256;
+    while (room < capacity) room *= 2;
+    Pro3Fingerprint *more = (Pro3Fingerprint *) aligned_alloc(PRO3_FINGERPRINT_ALIGN, sizeof(Pro3Fingerprint) * room);
+    if (more == NULL) return 0;
+    if (index->count) memcpy(more, index->fingerprint, sizeof(Pro3Fingerprint) * index->count);
+    free(index->fingerprint);
+    index->fingerprint = more;
+    index->capacity = room;
+    return 1;
+}
+
+/* Adds a fingerprint to the end of a Pro3Index. Returns its position, or -1 if there's no
+ * memory.
+ */
+int pro3_index_add(Pro3Index *index, const Pro3Fingerprint *fingerprint)
+{
+    if (!_pro3_index_reserve(index, index->count + 1)) return -1;
+    index->fingerprint[index->count] = *fingerprint;
+    return index->count++;
+}
+
+/* Finds the k fingerprints in a Pro3Index nearest to query, and puts their positions into
+ * position[] and their distances into distance[], nearest first. Returns how many were found,
+ * which is k, or the size of the index if that's smaller (and 0 if k is less than 1).
+ */
+int pro3_index_nearest(const Pro3Index *index, const Pro3Fingerprint *query, int k, int position[],
+                       uint32_t distance[])
+{
+    if (k < 1) return 0;
+    int found = 0;
+    int p;
+    for (p = 0; p < index->count; p++)
+    {
+        uint32_t d = pro3_fingerprint_distance(query, &index->fingerprint[p]);
+        if (found == k && d >= distance[k - 1]) continue;
+
+        /* Insert it in order, dropping the farthest if the list is full */
+        int i = (found < k) ? found++ : k - 1;
+        while (i > 0 && distance[i - 1] > d)
+        {
+            distance[i] = distance[i - 1];
+            position[i] = position[i - 1];
+            i--;
+        }
+        distance[i] = d;
+        position[i] = p;
+    }
+    return found;
+}
+
+/* Writes a Pro3Index to a file: 8 bytes of PRO3_INDEX_MAGIC, the count as a 32-bit number in
+ * this machine's byte order, and then the fingerprints as they are. Returns 1, or 0 if the file
+ * couldn't be written.
+ */
+int pro3_index_write(const Pro3Index *index, FILE *file)
+{
+    uint32_t count = index->count;
+    if (fwrite(PRO3_INDEX_MAGIC, 8, 1, file) != 1) return 0;
+    if (fwrite(&count, sizeof(count), 1, file) != 1) return 0;
+    if (count && fwrite(index->fingerprint, sizeof(Pro3Fingerprint), count, file) != count) return 0;
+    return 1;
+}
+
+/* Reads a Pro3Index written by pro3_index_write(). Returns NULL if the file isn't an index, is
+ * cut short, or if there's no memory.
+ */
+Pro3Index *pro3_index_read(FILE *file)
+{
+    char magic[8];
+    uint32_t count;
+    if (fread(magic, 8, 1, file) != 1 || memcmp(magic, PRO3_INDEX_MAGIC, 8)) return NULL;
+    if (fread(&count, sizeof(count), 1, file) != 1 || count > INT32_MAX / sizeof(Pro3Fingerprint)) return NULL;
+
+    Pro3Index *index = pro3_index_new();
+    if (index == NULL) return NULL;
+    if (count && (!_pro3_index_reserve(index, count)
+                  || fread(index->fingerprint, sizeof(Pro3Fingerprint), count, file) != count)) {
+        pro3_index_free(index);
+        return NULL;
+    }
+    index->count = count;
+    return index;
+}
+
+/* Frees a Pro3Index */
+void pro3_index_free(Pro3Index *index)
+{
+    if (index == NULL) return;
+    free(index->fingerprint);
+    free(index);
+}
+
+#endif /* PRO3_FINGERPRINT_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -0,0 +1,202 @@
+/* Pro 3 Harmonics (pro3_harmonics.h)
+ *
+ * Builds a Wavetable from harmonic descriptions of its 16 waveforms, for designing tables by the
+ * amplitude and phase of each harmonic, with curves that change from waveform to waveform.
+ *
+ * Each Pro3Spectrum gives the amplitude and phase of harmonics 1 to 511, which are all that a
+ * 1024-sample waveform can hold below the Nyquist frequency. Every waveform is made at every
+ * level of the mip pyramid, straight from its spectrum: the 512-sample level has harmonics 1 to
+ * 255, the 256-sample level 1 to 127, and the 128-sample level 1 to 63. So each smaller level is
+ * exactly band-limited, with nothing left above its Nyquist frequency to alias, and the levels
+ * are cached in the Wavetable, ready for export, rather than being made again from the full
+ * waveform with pcm_change_size(). (So wavetable_sysex_load() with check_mips reports
+ * PRO3_SYSEX_BAD_MIPS for these tables, since their levels aren't the ones it would make.)
+ *
+ * All 16 waveforms of each level are made in one batch of inverse transforms (see pcm_fft.h).
+ *
+ * pro3_spectrum_clear() sets every harmonic of a Pro3Spectrum to silence.
+ *
+ * wavetable_from_spectra() sets all 16 waveforms, and their smaller levels, from 16 spectra.
+ *
+ * wavetable_from_spectrum_function() does the same, with each spectrum made by a function.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_HARMONICS_H_
+#include <stdlib.h>
+#include <math.h>
+#include "pcm_fft.h"
+#include "pro3_wavetable.h"
+#define PRO3_HARMONICS_H_
+
+/* The highest harmonic of a 1024-sample waveform, below the Nyquist frequency */
+#define PRO3_HARMONICS ((PRO3_SAMPLE_SIZE / 2) - 1)
+
+/* The highest harmonic at level l of the mip pyramid (0 is 1024 samples, 3 is 128 samples) */
+#define PRO3_LEVEL_HARMONICS(l) (((PRO3_SAMPLE_SIZE >> (l)) / 2) - 1)
+
+/* A Pro3Spectrum describes one waveform as a sum of sine waves. Harmonic h has amplitude[h] and
+ * phase[h]. An amplitude of 1 is a full-scale sine wave, and phases are in radians. Index 0 (DC)
+ * isn't used.
+ */
+typedef struct _PRO3_SPECTRUM {
+    float amplitude[PRO3_HARMONICS + 1];
+    float phase[PRO3_HARMONICS + 1];
+} Pro3Spectrum;
+
+/* A Pro3SpectrumFunction fills in the spectrum of waveform num (0-15). arg is passed along from
+ * wavetable_from_spectrum_function(). The spectrum is cleared before each call.
+ */
+typedef void (*Pro3SpectrumFunction)(int num, Pro3Spectrum *spectrum, void *arg);
+
+/* Function declarations */
+void pro3_spectrum_clear(Pro3Spectrum *spectrum);
+int wavetable_from_spectra(Wavetable *table, const Pro3Spectrum spectra[], float peak);
+int wavetable_from_spectrum_function(Wavetable *table, Pro3SpectrumFunction function, void *arg, float peak);
+
+/* Sets every harmonic of a Pro3Spectrum to an amplitude of 0 and a phase of 0 */
+void pro3_spectrum_clear(Pro3Spectrum *spectrum)
+{
+    int h;
+    for (h = 0; h <= PRO3_HARMONICS; h++)
+    {
+        spectrum->amplitude[h] = 0;
+        spectrum->phase[h] = 0;
+    }
+}
+
+/*
+ * Sets all 16 waveforms of a Wavetable from 16 spectra, and sets each waveform's smaller levels
+ * from the harmonics that fit at that level. All the waveforms are marked as set.
+ *
+ * If peak is more than 0, the whole table is scaled by one gain, so that its largest sample is
+ * peak of full scale (1.0 is full scale), and the waveforms keep their levels relative to each
+ * other. If peak is 0, amplitudes are used as they are, and samples are clamped to 16 bits.
+ *
+ * Returns 1, or 0 if there's no memory.
+ */
+int wavetable_from_spectra(Wavetable *table, const Pro3Spectrum spectra[], float peak)
+{
+    /* The four levels are laid out one after the other, all 16 waveforms of each together */
+    int offset[5];
+    int l;
+    offset[0] = 0;
+    for (l = 0; l < 4; l++) offset[l + 1] = offset[l] + (PRO3_WAVES * (PRO3_SAMPLE_SIZE >> l));
+    float *re = (float *) calloc(offset[4], sizeof(float));
+    float *im = (float *) calloc(offset[4], sizeof(float));
+    PCMFFT *fft[4];
+    int ok = (re != NULL && im != NULL);
+    for (l = 0; l < 4; l++)
+    {
+        fft[l] = pcm_fft_new(PRO3_SAMPLE_SIZE >> l);
+        if (fft[l] == NULL) ok = 0;
+    }
+
+    if (ok) {
+        /* A sine at amplitude a and phase p is (a / 2)(sin p - i cos p) at bin h, and its
+         * conjugate at bin n - h, times n to undo the inverse transform's scaling
+         */
+        int k;
+        for (k = 0; k < PRO3_WAVES; k++)
+        {
+            const Pro3Spectrum *spectrum = &spectra[k];
+            int h;
+            for (h = 1; h <= PRO3_HARMONICS; h++)
+            {
+                float a = spectrum->amplitude[h];
+                if (a == 0) continue;
+                float bin_re = 0.5f * a * sinf(spectrum->phase[h]);
+                float bin_im = -0.5f * a * cosf(spectrum->phase[h]);
+                for (l = 0; l < 4 && h <= PRO3_LEVEL_HARMONICS(l); l++)
+                {
+                    int n = PRO3_SAMPLE_SIZE >> l;
+                    float *wre = re + offset[l] + (k * n);
+                    float *wim = im + offset[l] + (k * n);
+                    wre[h] = wre[n - h] = bin_re * n;
+                    wim[h] = bin_im * n;
+                    wim[n - h] = -bin_im * n;
+                }
+            }
+        }
+        for (l = 0; l < 4; l++) pcm_fft_inverse_batch(fft[l], re + offset[l], im + offset[l], PRO3_WAVES);
+
+        float gain = 32767.0f;
+        if (peak > 0) {
+            float max = 0;
+            int i;
+            for (i = 0; i < offset[4]; i++) if (fabsf(re[i]) > max) max = fabsf(re[i]);
+            gain = (max > 0) ? (peak * 32767.0f) / max : 0;
+        }
+
+        for (k = 0; k < PRO3_WAVES; k++)
+        {
+            pcm_sample_t *mip = table->mip[k];
+            for (l = 0; l < 4; l++)
+            {
+                int n = PRO3_SAMPLE_SIZE >> l;
+                const float *wave = re + offset[l] + (k * n);
+                pcm_sample_t *out = (l == 0) ? table->ref[k] : mip;
+                int i;
+                for (i = 0; i < n; i++)
+                {
+                    float v = wave[i] * gain;
+                    if (v > 32767) v = 32767;
+                    if (v < -32768) v = -32768;
+                    out[i] = (pcm_sample_t) lrintf(v);
+                }
+                if (l > 0) mip += n;
+            }
+            table->isset[k] = 1;
+            wavetable_touch(table, k);
+            table->mipset[k] = 1;
+        }
+    }
+
+    for (l = 0; l < 4; l++) pcm_fft_free(fft[l]);
+    free(re);
+    free(im);
+    return ok;
+}
+
+/* Sets all 16 waveforms of a Wavetable as wavetable_from_spectra() does, with the spectrum of
+ * each waveform made by function. Returns 1, or 0 if there's no memory.
+ */
+int wavetable_from_spectrum_function(Wavetable *table, Pro3SpectrumFunction function, void *arg, float peak)
+{
+    Pro3Spectrum *spectra = (Pro3Spectrum *) malloc(sizeof(Pro3Spectrum) * PRO3_WAVES);
+    if (spectra == NULL) return 0;
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        pro3_spectrum_clear(&spectra[k]);
+        function(k, &spectra[k], arg);
+    }
+    int ok = wavetable_from_spectra(table, spectra, peak);
+    free(spectra);
+    return ok;
+}
+
+#endif /* PRO3_HARMONICS_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -0,0 +1,247 @@
+/* Pro 3 Project (pro3_project.h)
+ *
+ * A project file keeps a Wavetable as it is in memory: which waveforms are set, the 16-bit
+ * samples of each waveform, the smaller levels that have been made from them, and the table's
+ * number and name. Unlike the system exclusive message, nothing in it is packed, and unlike
+ * wavetable_pcm_dump(), nothing is lost.
+ *
+ * The file is a fixed 64-byte header, then the waveforms as int16_t[16][1024], then the smaller
+ * levels as int16_t[16][896], each starting on a 64-byte boundary. Numbers are kept in the byte
+ * order of the machine that wrote the file, so that a file can be mapped into memory and used
+ * where it is. Opening one is a few checks of the header, with no parsing and no copying, so a
+ * library of thousands of tables opens as fast as the files can be mapped.
+ *
+ * The header has a version, and its own size, so that later versions of this code can add fields
+ * to the end of the header and still read the files written now. A file with a newer version than
+ * this code knows, or written on a machine with the other byte order, isn't opened.
+ *
+ * pro3_project_write() writes a Wavetable to a project file.
+ *
+ * pro3_project_open() maps a project file into memory.
+ *
+ * pro3_project_view() uses a project that's already in memory.
+ *
+ * pro3_project_store() copies a project into a Wavetable.
+ *
+ * pro3_project_close() unmaps a project file.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_PROJECT_H_
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pro3_wavetable.h"
+#define PRO3_PROJECT_H_
+
+/* The first 8 bytes of every project file */
+#define PRO3_PROJECT_MAGIC "PRO3WTP"
+
+/* The version this code writes, and the newest it reads */
+#define PRO3_PROJECT_VERSION 1
+
+/* Written in the writer's byte order. It reads back the same only on a machine with that order. */
+#define PRO3_PROJECT_BYTE_ORDER 0x01020304
+
+/* Each block of samples starts on a multiple of this many bytes */
+#define PRO3_PROJECT_ALIGN 64
+
+/* Results of pro3_project_open() and pro3_project_view() */
+#define PRO3_PROJECT_OK 0
+#define PRO3_PROJECT_BAD_FILE 1 /* Can't be opened or mapped, or the header is corrupt */
+#define PRO3_PROJECT_BAD_MAGIC 2 /* Not a project file */
+#define PRO3_PROJECT_BAD_VERSION 3 /* Made by a newer version */
+#define PRO3_PROJECT_BAD_ORDER 4 /* Written on a machine with the other byte order */
+#define PRO3_PROJECT_BAD_SIZE 5 /* The header, or the samples, don't fit in the file */
+
+/* The header at the start of a project file. Offsets are from the start of the file. */
+typedef struct _PRO3_PROJECT_HEADER {
+    char magic[8]; /* PRO3_PROJECT_MAGIC, with its NUL */
+    uint32_t version;
+    uint32_t byte_order; /* PRO3_PROJECT_BYTE_ORDER */
+    uint32_t header_size; /* Size of the header in this file, at least 64 bytes */
+    uint32_t file_size;
+    uint32_t ref_offset; /* int16_t[16][1024] waveforms */
+    uint32_t mip_offset; /* int16_t[16][PRO3_MIP_SIZE] smaller levels */
+    uint16_t isset; /* Bit k is set if waveform k has been set */
+    uint16_t mipset; /* Bit k is set if waveform k's smaller levels are in the file */
+    uint16_t num; /* Zero-indexed wavetable number */
+    char name[9];
+    char reserved[17];
+} Pro3ProjectHeader;
+
+_Static_assert(sizeof(Pro3ProjectHeader) == PRO3_PROJECT_ALIGN, "Pro3ProjectHeader must be 64 bytes");
+
+/* A Pro3Project points into a project file in memory */
+typedef struct _PRO3_PROJECT {
+    const Pro3ProjectHeader *header;
+    const int16_t (*ref)[PRO3_SAMPLE_SIZE];
+    const int16_t (*mip)[PRO3_MIP_SIZE];
+    void *map; /* The mapping made by pro3_project_open(), or NULL */
+    size_t size;
+} Pro3Project;
+
+/* Function declarations */
+int pro3_project_write(Wavetable *table, int num, const char *name, FILE *file);
+int pro3_project_open(Pro3Project *project, const char *path);
+int pro3_project_view(Pro3Project *project, const void *data, size_t size);
+void pro3_project_store(const Pro3Project *project, Wavetable *table);
+void pro3_project_close(Pro3Project *project);
+
+/* Writes a Wavetable to a file as a project, with a zero-indexed wavetable number and a name of
+ * up to 8 characters. The smaller levels of every waveform are made, if they haven't been, and
+ * written too. Returns 1, or 0 if the file couldn't be written.
+ */
+int pro3_project_write(Wavetable *table, int num, const char *name, FILE *file)
+{
+    Pro3ProjectHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PRO3_PROJECT_MAGIC, sizeof(header.magic));
+    header.version = PRO3_PROJECT_VERSION;
+    header.byte_order = PRO3_PROJECT_BYTE_ORDER;
+    header.header_size = sizeof(header);
+    header.ref_offset = sizeof(header);
+    header.mip_offset = header.ref_offset + sizeof(int16_t) * PRO3_WAVES * PRO3_SAMPLE_SIZE;
+    header.file_size = header.mip_offset + sizeof(int16_t) * PRO3_WAVES * PRO3_MIP_SIZE;
+    header.num = num;
+    strncpy(header.name, name, 8);
+
+    int16_t ref[PRO3_WAVES][PRO3_SAMPLE_SIZE];
+    int16_t mip[PRO3_WAVES][PRO3_MIP_SIZE];
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        const pcm_sample_t *levels = wavetable_mips(table, k);
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) ref[k][i] = (int16_t) table->ref[k][i];
+        for (i = 0; i < PRO3_MIP_SIZE; i++) mip[k][i] = (int16_t) levels[i];
+        if (table->isset[k]) header.isset |= 1 << k;
+        header.mipset |= 1 << k;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1) return 0;
+    if (fwrite(ref, sizeof(ref), 1, file) != 1) return 0;
+    if (fwrite(mip, sizeof(mip), 1, file) != 1) return 0;
+    return 1;
+}
+
+/* Maps a project file into memory, read-only, and points project into it. Returns
+ * PRO3_PROJECT_OK, or one of the PRO3_PROJECT_BAD_ results, in which case nothing is left mapped.
+ * Close an opened project with pro3_project_close().
+ */
+int pro3_project_open(Pro3Project *project, const char *path)
+{
+    project->map = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return PRO3_PROJECT_BAD_FILE;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return PRO3_PROJECT_BAD_FILE;
+    }
+    if (st.st_size < (off_t) sizeof(Pro3ProjectHeader)) {
+        close(fd);
+        return PRO3_PROJECT_BAD_SIZE;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* The mapping stays */
+    if (map == MAP_FAILED) return PRO3_PROJECT_BAD_FILE;
+
+    int result = pro3_project_view(project, map, st.st_size);
+    if (result != PRO3_PROJECT_OK) {
+        munmap(map, st.st_size);
+        return result;
+    }
+    project->map = map;
+    return PRO3_PROJECT_OK;
+}
+
+/* Points project into a project file that's already in memory, at data, which should be aligned
+ * to PRO3_PROJECT_ALIGN bytes. The data isn't copied, and has to stay where it is while the
+ * project is used. Returns PRO3_PROJECT_OK, or one of the PRO3_PROJECT_BAD_ results. A header
+ * whose name isn't NUL-terminated is PRO3_PROJECT_BAD_FILE, so the name is always safe to use.
+ */
+int pro3_project_view(Pro3Project *project, const void *data, size_t size)
+{
+    const Pro3ProjectHeader *header = (const Pro3ProjectHeader *) data;
+    if (size < sizeof(Pro3ProjectHeader)) return PRO3_PROJECT_BAD_SIZE;
+    if (memcmp(header->magic, PRO3_PROJECT_MAGIC, sizeof(header->magic))) return PRO3_PROJECT_BAD_MAGIC;
+    if (header->byte_order != PRO3_PROJECT_BYTE_ORDER) return PRO3_PROJECT_BAD_ORDER;
+    if (header->version == 0 || header->version > PRO3_PROJECT_VERSION) return PRO3_PROJECT_BAD_VERSION;
+    if (header->name[sizeof(header->name) - 1] != '\0') return PRO3_PROJECT_BAD_FILE;
+
+    size_t ref_size = sizeof(int16_t) * PRO3_WAVES * PRO3_SAMPLE_SIZE;
+    size_t mip_size = sizeof(int16_t) * PRO3_WAVES * PRO3_MIP_SIZE;
+    if (header->header_size < sizeof(Pro3ProjectHeader) || header->file_size > size
+        || header->ref_offset % PRO3_PROJECT_ALIGN || header->mip_offset % PRO3_PROJECT_ALIGN
+        || header->ref_offset < header->header_size || header->mip_offset < header->header_size
+        || (size_t) header->ref_offset + ref_size > header->file_size
+        || (size_t) header->mip_offset + mip_size > header->file_size) {
+        return PRO3_PROJECT_BAD_SIZE;
+    }
+
+    const unsigned char *base = (const unsigned char *) data;
+    project->header = header;
+    project->ref = (const int16_t (*)[PRO3_SAMPLE_SIZE]) (base + header->ref_offset);
+    project->mip = (const int16_t (*)[PRO3_MIP_SIZE]) (base + header->mip_offset);
+    project->map = NULL;
+    project->size = size;
+    return PRO3_PROJECT_OK;
+}
+
+/* Copies a project's waveforms into a Wavetable, and marks the ones that were set. The smaller
+ * levels in the project are kept as the Wavetable's cached levels (see wavetable_mips()).
+ */
+void pro3_project_store(const Pro3Project *project, Wavetable *table)
+{
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[k][i] = project->ref[k][i];
+        table->isset[k] = (project->header->isset >> k) & 1;
+        wavetable_touch(table, k);
+        if ((project->header->mipset >> k) & 1) {
+            for (i = 0; i < PRO3_MIP_SIZE; i++) table->mip[k][i] = project->mip[k][i];
+            table->mipset[k] = 1;
+        }
+    }
+}
+
+/* Unmaps a project opened with pro3_project_open(). A project from pro3_project_view() is left
+ * alone.
+ */
+void pro3_project_close(Pro3Project *project)
+{
+    if (project->map != NULL) munmap(project->map, project->size);
+    project->map = NULL;
+}
+
+#endif /* PRO3_PROJECT_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
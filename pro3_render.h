@@ -0,0 +1,286 @@
+/* Pro 3 Render (pro3_render.h)
+ *
+ * Plays a Wavetable as an oscillator, offline, so that a table can be heard and measured before
+ * it's sent to the synth. Each voice plays at one pitch, and moves through the 16 waveforms
+ * along a morph envelope. Like the Pro 3, a voice plays the level of the mip pyramid (1024,
+ * 512, 256, or 128 samples) that suits its pitch, so high notes alias as they will on the synth
+ * and no more.
+ *
+ * Voices are rendered a block at a time into float buffers, which many voices can be added into,
+ * and which can then be turned into PCM and written with a WAVWriter (see pcm_stream.h).
+ *
+ * pro3_render_table_new() prepares a Wavetable for rendering.
+ *
+ * pro3_render_table_free() frees a Pro3RenderTable.
+ *
+ * pro3_mip_level() returns the level of the mip pyramid to use for a pitch.
+ *
+ * pro3_envelope() returns a Pro3Envelope that morphs from one position to another.
+ *
+ * pro3_envelope_add() adds a point to a Pro3Envelope.
+ *
+ * pro3_envelope_value() returns the morph position of a Pro3Envelope at a time.
+ *
+ * pro3_voice_new() creates a Pro3Voice that plays a Pro3RenderTable.
+ *
+ * pro3_voice_render() adds a block of a voice's output to a float buffer.
+ *
+ * pro3_render_quantize() turns a float buffer into PCM data.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef PRO3_RENDER_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pro3_wavetable.h"
+#define PRO3_RENDER_H_
+
+/* Morph position is worked out once for each block of this many frames */
+#define PRO3_RENDER_BLOCK 64
+
+/* The most points in a Pro3Envelope */
+#define PRO3_ENVELOPE_POINTS 16
+
+/* The levels of the mip pyramid, from 1024 samples (0) to 128 samples (3) */
+#define PRO3_LEVELS 4
+
+/* Offset of level l in a Pro3RenderTable waveform. Each level has one extra sample at the end,
+ * a copy of its first, so interpolation never has to wrap.
+ */
+#define PRO3_LEVEL_OFFSET(l) ((2 * PRO3_SAMPLE_SIZE) - ((2 * PRO3_SAMPLE_SIZE) >> (l)) + (l))
+
+/* Floats in each Pro3RenderTable waveform */
+#define PRO3_RENDER_WAVE_SIZE (PRO3_LEVEL_OFFSET(PRO3_LEVELS))
+
+/* A Pro3RenderTable is a Wavetable's waveforms, at every level, as floats from -1 to 1 */
+typedef struct _PRO3_RENDER_TABLE {
+    float wave[PRO3_WAVES][PRO3_RENDER_WAVE_SIZE];
+} Pro3RenderTable;
+
+/* A Pro3Envelope is a series of morph positions (0 is the first waveform, 15 the last), each at
+ * a time in seconds. The position moves in a straight line from each point to the next, and
+ * holds at the first and last points.
+ */
+typedef struct _PRO3_ENVELOPE {
+    int count;
+    float time[PRO3_ENVELOPE_POINTS];
+    float position[PRO3_ENVELOPE_POINTS];
+} Pro3Envelope;
+
+/* A Pro3Voice plays one note */
+typedef struct _PRO3_VOICE {
+    const Pro3RenderTable *table;
+    Pro3Envelope envelope;
+    long rate;
+    int level; /* Level of the mip pyramid */
+    int size; /* Samples in the level */
+    double phase; /* Position in the level, in samples */
+    double increment; /* Samples to move for each frame */
+    float gain;
+    pcm_offset_t frames; /* Frames rendered so far */
+} Pro3Voice;
+
+/* Function declarations */
+Pro3RenderTable *pro3_render_table_new(Wavetable *table);
+void pro3_render_table_free(Pro3RenderTable *render);
+int pro3_mip_level(float frequency, long rate);
+Pro3Envelope pro3_envelope(float start, float end, float seconds);
+void pro3_envelope_add(Pro3Envelope *envelope, float time, float position);
+float pro3_envelope_value(const Pro3Envelope *envelope, float time);
+Pro3Voice pro3_voice_new(const Pro3RenderTable *table, float frequency, long rate, Pro3Envelope envelope, float gain);
+void pro3_voice_render(Pro3Voice *voice, float out[], pcm_size_t frames);
+void pro3_render_quantize(const float in[], pcm_sample_t out[], pcm_size_t size, int resolution);
+
+/* Makes a Pro3RenderTable from the levels of a Wavetable's waveforms, as wavetable_sysex() would
+ * send them. Returns NULL if there's no memory.
+ */
+Pro3RenderTable *pro3_render_table_new(Wavetable *table)
+{
+    Pro3RenderTable *render = (Pro3RenderTable *) malloc(sizeof(Pro3RenderTable));
+    if (render == NULL) return NULL;
+
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        const pcm_sample_t *level = table->ref[k];
+        const pcm_sample_t *mip = wavetable_mips(table, k);
+        int l;
+        for (l = 0; l < PRO3_LEVELS; l++)
+        {
+            int size = PRO3_SAMPLE_SIZE >> l;
+            float *dst = render->wave[k] + PRO3_LEVEL_OFFSET(l);
+            int i;
+            for (i = 0; i < size; i++) dst[i] = (int16_t) level[i] / 32768.0f;
+            dst[size] = dst[0];
+            level = (l == 0) ? mip : level + size;
+        }
+    }
+    return render;
+}
+
+/* Frees a Pro3RenderTable */
+void pro3_render_table_free(Pro3RenderTable *render)
+{
+    free(render);
+}
+
+/* Returns the level of the mip pyramid (0 for 1024 samples, up to 3 for 128 samples) to play at
+ * a frequency. It's the largest level that doesn't have more samples in a cycle than the output
+ * does, so playback never skips over samples; notes above rate / 128 Hz (about 345 Hz at
+ * 44.1 kHz) all play the 128-sample level.
+ */
+int pro3_mip_level(float frequency, long rate)
+{
+    int l = 0;
+    while (l < PRO3_LEVELS - 1 && (PRO3_SAMPLE_SIZE >> l) * frequency > rate) l++;
+    return l;
+}
+
+/* Returns a Pro3Envelope that morphs from the start position to the end position over a number
+ * of seconds
+ */
+Pro3Envelope pro3_envelope(float start, float end, float seconds)
+{
+    Pro3Envelope envelope;
+    envelope.count = 0;
+    pro3_envelope_add(&envelope, 0, start);
+    pro3_envelope_add(&envelope, seconds, end);
+    return envelope;
+}
+
+/* Adds a point to the end of a Pro3Envelope. Points should be added in order of time. Positions
+ * are clamped to the waveforms there are.
+ */
+void pro3_envelope_add(Pro3Envelope *envelope, float time, float position)
+{
+    if (envelope->count >= PRO3_ENVELOPE_POINTS) return;
+    if (position < 0) position = 0;
+    if (position > PRO3_WAVES - 1) position = PRO3_WAVES - 1;
+    envelope->time[envelope->count] = time;
+    envelope->position[envelope->count] = position;
+    envelope->count++;
+}
+
+/* Returns the morph position of a Pro3Envelope at a time in seconds */
+float pro3_envelope_value(const Pro3Envelope *envelope, float time)
+{
+    if (envelope->count == 0) return 0;
+    if (time <= envelope->time[0]) return envelope->position[0];
+    int p;
+    for (p = 1; p < envelope->count; p++)
+    {
+        if (time < envelope->time[p]) {
+            float span = envelope->time[p] - envelope->time[p - 1];
+            float scale = (time - envelope->time[p - 1]) / span;
+            return envelope->position[p - 1] + (envelope->position[p] - envelope->position[p - 1]) * scale;
+        }
+    }
+    return envelope->position[envelope->count - 1];
+}
+
+/* Creates a Pro3Voice that plays a Pro3RenderTable at a frequency in Hz, at a sample rate, with
+ * a morph envelope and a gain
+ */
+Pro3Voice pro3_voice_new(const Pro3RenderTable *table, float frequency, long rate, Pro3Envelope envelope, float gain)
+{
+    Pro3Voice voice;
+    voice.table = table;
+    voice.envelope = envelope;
+    voice.rate = rate;
+    voice.level = pro3_mip_level(frequency, rate);
+    voice.size = PRO3_SAMPLE_SIZE >> voice.level;
+    voice.phase = 0;
+    voice.increment = (double) frequency * voice.size / rate;
+    voice.gain = gain;
+    voice.frames = 0;
+    return voice;
+}
+
+/*
+ * Adds frames frames of a voice's output to out[]. The morph position is worked out at the start
+ * of each block of PRO3_RENDER_BLOCK frames. Within a block, each frame is interpolated linearly
+ * between samples, in the two waveforms on either side of the morph position, and then between
+ * those two waveforms. The phase of each frame in a block is found first, so that the inner
+ * loop has no dependency from one frame to the next, and the compiler can vectorize it.
+ */
+void pro3_voice_render(Pro3Voice *voice, float out[], pcm_size_t frames)
+{
+    pcm_size_t done = 0;
+    while (done < frames)
+    {
+        int block = (frames - done > PRO3_RENDER_BLOCK) ? PRO3_RENDER_BLOCK : (int) (frames - done);
+
+        float position = pro3_envelope_value(&voice->envelope, (float) voice->frames / voice->rate);
+        int k = (int) position;
+        if (k > PRO3_WAVES - 2) k = PRO3_WAVES - 2;
+        float morph = position - k;
+        const float *a = voice->table->wave[k] + PRO3_LEVEL_OFFSET(voice->level);
+        const float *b = voice->table->wave[k + 1] + PRO3_LEVEL_OFFSET(voice->level);
+
+        int ix[PRO3_RENDER_BLOCK];
+        float frac[PRO3_RENDER_BLOCK];
+        double phase = voice->phase;
+        int n;
+        for (n = 0; n < block; n++)
+        {
+            ix[n] = (int) phase;
+            frac[n] = (float) (phase - ix[n]);
+            phase += voice->increment;
+            while (phase >= voice->size) phase -= voice->size;
+        }
+        voice->phase = phase;
+
+        float *dst = out + done;
+        float gain = voice->gain;
+        for (n = 0; n < block; n++)
+        {
+            int i = ix[n];
+            float sa = a[i] + (a[i + 1] - a[i]) * frac[n];
+            float sb = b[i] + (b[i + 1] - b[i]) * frac[n];
+            dst[n] += (sa + (sb - sa) * morph) * gain;
+        }
+
+        voice->frames += block;
+        done += block;
+    }
+}
+
+/* Turns size floats from -1 to 1 into signed PCM data of a resolution, rounding and clamping */
+void pro3_render_quantize(const float in[], pcm_sample_t out[], pcm_size_t size, int resolution)
+{
+    float max = (float) ((1UL << (resolution - 1)) - 1);
+    pcm_index_t i;
+    for (i = 0; i < size; i++)
+    {
+        float v = in[i] * (max + 1);
+        if (v > max) v = max;
+        if (v < -1 - max) v = -1 - max;
+        out[i] = (pcm_sample_t) lrintf(v);
+    }
+}
+
+#endif /* PRO3_RENDER_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
@@ -5,23 +5,91 @@
  * exclusive data for the Sequential Pro 3 synthesizer.
  * 
 s */
+#ifndef PRO3_WAVETABLE_H_
+#include <string.h>
 #include "sequential_packing.h"
 #include "pcm_proc.h"
+#include "pcm_fixed.h"
+#include "pcm_fft.h"
+#include "pcm_resample.h"
+#define PRO3_WAVETABLE_H_
 #define PCM_MAX 176000
 #define PRO3_SAMPLE_SIZE 1024
 #define PRO3_WAVES 16
 
-/* A Wavetable is a set of 16 reference waveforms represented as PCM */
+/* The size of a complete wavetable system exclusive message: 17 bytes of header and name,
+ * 98304 bytes of data packed into 112348, two bytes of checksum, and the end byte
+ */
+#define PRO3_SYSEX_SIZE 112368
+
+/* The size of a wavetable's data before packing: 16 waveforms of 1024 + 512 + (2 * 256) +
+ * (8 * 128) 16-bit words
+ */
+#define PRO3_DATA_SIZE 98304
+
+/* Results of wavetable_sysex_load() */
+#define PRO3_SYSEX_OK 0
+#define PRO3_SYSEX_BAD_HEADER 1 /* Not a Pro 3 wavetable message */
+#define PRO3_SYSEX_BAD_SIZE 2 /* Too short, or doesn't end with F7 */
+#define PRO3_SYSEX_BAD_CHECKSUM 3 /* The data doesn't match the checksum */
+#define PRO3_SYSEX_BAD_MIPS 4 /* The smaller levels weren't made from the full waveforms */
+
+/* Each waveform is also sent at 512, 256, and 128 samples, one after the other */
+#define PRO3_MIP_SIZE ((PRO3_SAMPLE_SIZE / 2) + (PRO3_SAMPLE_SIZE / 4) + (PRO3_SAMPLE_SIZE / 8))
+
+/* Half the width of the frame-axis low-pass filter, in output frames */
+#define PRO3_FRAME_FILTER_WIDTH 2
+
+/* Ways of filling in empty reference waveforms, for wavetable_fill_mode() */
+#define PRO3_FILL_LINEAR 0 /* Straight line from one set waveform to the next */
+#define PRO3_FILL_EQUAL_POWER 1 /* Quarter-sine crossfade, for waveforms that don't correlate */
+#define PRO3_FILL_COSINE 2 /* Eases out of one set waveform and into the next */
+#define PRO3_FILL_CUBIC 3 /* Catmull-Rom spline through all the set waveforms */
+#define PRO3_FILL_SPECTRAL 4 /* As wavetable_fill_spectral() */
+
+/* How many times level l (0 is the full waveform, 3 is 128 samples) is sent */
+#define PRO3_LEVEL_REPEAT(l) ((l) == 3 ? 8 : ((l) == 2 ? 2 : 1))
+
+/* A Wavetable is a set of 16 reference waveforms represented as PCM. The smaller levels of
+ * each waveform are kept in mip once they've been made, until the waveform changes. Code that
+ * writes to ref directly should call wavetable_touch() for each waveform it changes.
+ */
 typedef struct _Wavetable {
     pcm_sample_t ref[PRO3_WAVES][PRO3_SAMPLE_SIZE];
     int isset[PRO3_WAVES];
+    pcm_sample_t mip[PRO3_WAVES][PRO3_MIP_SIZE];
+    int mipset[PRO3_WAVES]; /* 1 if mip holds the levels of the current waveform */
+    int dirty[PRO3_WAVES]; /* 1 if the waveform has changed since wavetable_sysex_update() */
 } Wavetable;
 
+/* Pro3SysexImage keeps the last system exclusive message that wavetable_sysex_update() built for
+ * a Wavetable, so that it can be patched where the waveforms have changed. Each waveform's part
+ * of the checksum is kept too. Set size to 0 before first use, and use one image per Wavetable.
+ */
+typedef struct _PRO3_SYSEX_IMAGE {
+    unsigned char sysex[PRO3_SYSEX_SIZE];
+    unsigned long size; /* 0 until the message has been built */
+    uint16_t sum[PRO3_WAVES]; /* Each waveform's words, with their bytes swapped, added up */
+} Pro3SysexImage;
+
 /* Function declarations */
 Wavetable new_Wavetable();
 void set_reference(Wavetable *table, PCMData *reference, int num);
+void wavetable_from_slice(Wavetable *table, PCMSlice source, pcm_size_t cycle);
+int wavetable_from_frames(Wavetable *table, PCMSlice source, pcm_size_t cycle);
+void wavetable_resample_frames(Wavetable *table, const pcm_sample_t frames[], int count);
 void wavetable_fill(Wavetable *table);
+void wavetable_fill_mode(Wavetable *table, int mode);
+void wavetable_fill_fixed(Wavetable *table);
+void wavetable_fill_spectral(Wavetable *table);
+void wavetable_align(Wavetable *table);
+void wavetable_touch(Wavetable *table, int num);
+const pcm_sample_t *wavetable_mips(Wavetable *table, int num);
+unsigned long wavetable_sysex(Wavetable *table, int num, const char *name, unsigned char sysex[]);
+unsigned long wavetable_sysex_update(Wavetable *table, int num, const char *name, Pro3SysexImage *image);
 void wavetable_sysex_dump(Wavetable *table, int num, char *name);
+int wavetable_sysex_load(Wavetable *table, const unsigned char sysex[], unsigned long size, int *num, char name[],
+                         int check_mips);
 void wavetable_pcm_dump(Wavetable *table);
 
 /* Create a new empty PRO 3 wavetable */
@@ -32,6 +100,8 @@ Wavetable new_Wavetable()
     for (i = 0; i < PRO3_WAVES; i++) 
     {
         table.isset[i] = 0;
+        table.mipset[i] = 0;
+        table.dirty[i] = 1;
         int j;
         for (j = 0; j < PRO3_SAMPLE_SIZE; j++) table.ref[i][j] = 0;
     }
@@ -39,165 +109,818 @@ Wavetable new_Wavetable()
 }
 
 /* Insert a PCM waveform into a Wavetable 
- * Prior to insertion, set waveform to 16-bit, 1024 samples
+ * Prior to insertion, set waveform to 16-bit, 1024 samples. A waveform that's already
+ * 16-bit and 1024 samples is read in place, so the clone is only made when it has to change.
  */
 void set_reference(Wavetable *table, PCMData *reference, int num)
 {
-    PCMData clone = pcm_clone(reference);
-    if (clone.size != PRO3_SAMPLE_SIZE) pcm_change_size(&clone, PRO3_SAMPLE_SIZE);
-    if (clone.resolution != 16) pcm_change_resolution(&clone, 16);
     int i;
-    for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
-    {
-        table->ref[num][i] = clone.data[i];
+    if (reference->size == PRO3_SAMPLE_SIZE && reference->resolution == 16) {
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[num][i] = reference->data[i];
+    } else {
+        PCMData clone = pcm_clone(reference);
+        if (clone.size != PRO3_SAMPLE_SIZE) pcm_change_size(&clone, PRO3_SAMPLE_SIZE);
+        if (clone.resolution != 16) pcm_change_resolution(&clone, 16);
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+        {
+            table->ref[num][i] = clone.data[i];
+        }
     }
     table->isset[num] = 1;
+    wavetable_touch(table, num);
     return;
 }
 
+/* Set all 16 reference waveforms from cycles of cycle samples taken from evenly-spaced points
+ * in source, from its start to its end. The source should be mono (see pcm_mix_down() in
+ * pcm_mix.h); for a multichannel source, the left channel is used.
+ */
+void wavetable_from_slice(Wavetable *table, PCMSlice source, pcm_size_t cycle)
+{
+    if (cycle == 0 || source.size < cycle) return;
+    source = pcm_slice_channel(source, PCM_PROC_CHANNEL_LEFT);
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        pcm_index_t start = ((source.size - cycle) * k) / (PRO3_WAVES - 1);
+        PCMData wave = pcm_slice_copy(pcm_slice_trim(source, start, cycle));
+        set_reference(table, &wave, k);
+    }
+}
+
+/*
+ * Frame-axis resampling treats a wavetable of count frames as a 2-D array, and resamples it along
+ * the frame axis to 16 frames. Output frame k sits at input frame k * (count - 1) / 15, so the
+ * first and last frames line up. With more than 16 frames, each output frame is a low-pass
+ * filtered (Hann-windowed sinc) mix of the input frames around it, so changes from frame to frame
+ * that are too fast for 16 frames to follow are smoothed out, rather than skipped over. With 16
+ * frames or fewer, each output frame is interpolated linearly between the input frames on either
+ * side of it.
+ *
+ * Input frames are taken one at a time, and each is added into every output frame it has a
+ * weight in, so the input is read once, front to back, while the 16 output frames (as floats)
+ * stay in cache. The inner loop runs along the 1024-sample axis, where it can be vectorized. At
+ * the ends, weights that fall outside the table are left out, and each output frame is divided
+ * by the total of its weights.
+ */
+
+/* Returns the weight of input frame j in output frame k, for a table of count frames */
+float _pro3_frame_weight(int count, int k, int j)
+{
+    double d = j - ((double) k * (count - 1) / (PRO3_WAVES - 1)); /* Distance in input frames */
+    if (count <= PRO3_WAVES) return (fabs(d) < 1.0) ? (float) (1.0 - fabs(d)) : 0;
+
+    double x = d * (PRO3_WAVES - 1) / (count - 1); /* Distance in output frames */
+    if (fabs(x) >= PRO3_FRAME_FILTER_WIDTH) return 0;
+    double sinc = (x == 0) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+    double window = 0.5 + 0.5 * cos(M_PI * x / PRO3_FRAME_FILTER_WIDTH);
+    return (float) (sinc * window);
+}
+
+/* Adds input frame j, of count frames, into each output frame it has a weight in */
+void _pro3_frame_add(float acc[][PRO3_SAMPLE_SIZE], float total[], int count, int j, const float frame[])
+{
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        float w = _pro3_frame_weight(count, k, j);
+        if (w == 0) continue;
+        total[k] += w;
+        float *a = acc[k];
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) a[i] += w * frame[i];
+    }
+}
+
+/* Sets every reference waveform from the added-up output frames */
+void _pro3_frame_finish(Wavetable *table, float acc[][PRO3_SAMPLE_SIZE], const float total[])
+{
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        float scale = total[k] ? 1.0f / total[k] : 0;
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+        {
+            /* Rounded inline and clamped as an integer, so the loop vectorizes */
+            float v = acc[k][i] * scale;
+            pcm_sample_t r = (pcm_sample_t) (v + (v < 0 ? -0.5f : 0.5f));
+            if (r > 32767) r = 32767;
+            if (r < -32768) r = -32768;
+            table->ref[k][i] = r;
+        }
+        table->isset[k] = 1;
+        wavetable_touch(table, k);
+    }
+}
+
+/* Set all 16 reference waveforms by resampling count frames of 1024 16-bit samples, laid end to
+ * end in frames[], along the frame axis (see above). Does nothing if there's no memory.
+ */
+void wavetable_resample_frames(Wavetable *table, const pcm_sample_t frames[], int count)
+{
+    if (count < 1) return;
+    float (*acc)[PRO3_SAMPLE_SIZE] = (float (*)[PRO3_SAMPLE_SIZE]) calloc((PRO3_WAVES + 1) * PRO3_SAMPLE_SIZE, sizeof(float));
+    if (acc == NULL) return;
+    float *frame = acc[PRO3_WAVES];
+    float total[PRO3_WAVES] = {0};
+    int j;
+    for (j = 0; j < count; j++)
+    {
+        const pcm_sample_t *in = frames + ((pcm_index_t) j * PRO3_SAMPLE_SIZE);
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) frame[i] = (float) in[i];
+        _pro3_frame_add(acc, total, count, j, frame);
+    }
+    _pro3_frame_finish(table, acc, total);
+    free(acc);
+}
+
+/* Set all 16 reference waveforms from a multi-frame wavetable, like the WAV files made by Serum
+ * and Vital, where frame after frame of cycle samples (often 2048) are laid end to end. Each
+ * frame is a view into source, and is resampled to 1024 samples with pcm_resample_cycle(), so
+ * harmonics that won't fit are filtered out rather than aliased. For a multichannel source, the
+ * left channel is used.
+ *
+ * The frames are then resampled to 16 along the frame axis, as wavetable_resample_frames() does,
+ * each frame being added in as soon as it's been resampled, so the source is read once. Returns
+ * the number of frames in the source, or 0 if there isn't a whole frame (or there's no memory).
+ */
+int wavetable_from_frames(Wavetable *table, PCMSlice source, pcm_size_t cycle)
+{
+    if (cycle == 0 || source.size < cycle) return 0;
+    source = pcm_slice_channel(source, PCM_PROC_CHANNEL_LEFT);
+    int frames = (int) (source.size / cycle);
+    pcm_sample_t *work = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * (cycle + PRO3_SAMPLE_SIZE));
+    float (*acc)[PRO3_SAMPLE_SIZE] = (float (*)[PRO3_SAMPLE_SIZE]) calloc((PRO3_WAVES + 1) * PRO3_SAMPLE_SIZE, sizeof(float));
+    if (work == NULL || acc == NULL) {
+        free(work);
+        free(acc);
+        return 0;
+    }
+    pcm_sample_t *resampled = work + cycle;
+    float *frame = acc[PRO3_WAVES];
+    float total[PRO3_WAVES] = {0};
+
+    /* Samples are brought to 16 bits, as set_reference() does, but kept as floats */
+    float offset = (source.resolution == 8) ? 128.0f : 0;
+    float scale = (source.resolution == 8) ? 256.0f : ldexpf(1.0f, 16 - source.resolution);
+
+    int j;
+    for (j = 0; j < frames; j++)
+    {
+        PCMSlice view = pcm_slice_trim(source, (pcm_index_t) j * cycle, cycle);
+        pcm_index_t i;
+        for (i = 0; i < cycle; i++) work[i] = view.data[i * view.stride];
+        if (!pcm_resample_cycle(work, cycle, resampled, PRO3_SAMPLE_SIZE, source.resolution)) {
+            free(work);
+            free(acc);
+            return 0;
+        }
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) frame[i] = (resampled[i] - offset) * scale;
+        _pro3_frame_add(acc, total, frames, j, frame);
+    }
+    _pro3_frame_finish(table, acc, total);
+
+    free(work);
+    free(acc);
+    return frames;
+}
+
 /* Fill in empty reference waveforms by morphing with linear interpolation.
  * At least one reference waveform must be set in 0
  */
 void wavetable_fill(Wavetable *table)
 {
-    /* If the first waveform isn't set, return return without doing anything */
+    wavetable_fill_mode(table, PRO3_FILL_LINEAR);
+}
+
+/* Sets out[] to a + (b - a) * scale, truncated */
+void _pro3_fill_lerp(const pcm_sample_t a[], const pcm_sample_t b[], float scale, pcm_sample_t out[])
+{
+    int i;
+    for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+    {
+        float pcm_diff = b[i] - a[i];
+        out[i] = (pcm_sample_t) (a[i] + (pcm_diff * scale));
+    }
+}
+
+/* Sets out[] to the sum of four waveforms, each times its weight, rounded half away from zero and
+ * clamped to 16 bits. The rounding is done inline, rather than with lrintf(), and the clamp on
+ * the rounded integer, so that the loop vectorizes. The weights are never large enough for the
+ * sum to leave the range of an int.
+ */
+void _pro3_fill_blend(const pcm_sample_t *p[4], const float w[4], pcm_sample_t out[])
+{
+    const pcm_sample_t *p0 = p[0], *p1 = p[1], *p2 = p[2], *p3 = p[3];
+    int i;
+    for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+    {
+        float v = (p0[i] * w[0]) + (p1[i] * w[1]) + (p2[i] * w[2]) + (p3[i] * w[3]);
+        pcm_sample_t r = (pcm_sample_t) (v + (v < 0 ? -0.5f : 0.5f));
+        if (r > 32767) r = 32767;
+        if (r < -32768) r = -32768;
+        out[i] = r;
+    }
+}
+
+/*
+ * Fill in empty reference waveforms, by one of the PRO3_FILL_ modes. As with wavetable_fill(),
+ * the first waveform must be set, and the last is set to the first if it isn't set.
+ * PRO3_FILL_LINEAR spreads each gap as wavetable_fill() always has, so that the gap's last
+ * waveform is the same as the set waveform after it. The other modes spread each gap evenly
+ * between the set waveforms on either side, reaching the second one at its own position, so the
+ * modes differ even on a gap of one waveform.
+ *
+ * The set waveforms are found first, and then every gap is filled in one sweep. The weights of
+ * the set waveforms are worked out once for each waveform that's filled, so the loop over its
+ * samples is just multiplies, adds, and an inline rounding, which the compiler can vectorize.
+ *
+ * PRO3_FILL_EQUAL_POWER keeps the level steady through the morph when the two waveforms don't
+ * correlate, but bulges by up to 3 dB when they're alike. PRO3_FILL_CUBIC passes through every
+ * set waveform with no corners, so the morph doesn't change direction all at once at each one;
+ * it can overshoot, and is clamped to 16 bits.
+ */
+void wavetable_fill_mode(Wavetable *table, int mode)
+{
+    if (mode == PRO3_FILL_SPECTRAL) {
+        wavetable_fill_spectral(table);
+        return;
+    }
+
+    /* If the first waveform isn't set, return without doing anything */
     if (table->isset[0] == 0) return;
 
     /* If the last waveform isn't set, fill the last position with the first wave */
     if (table->isset[PRO3_WAVES - 1] == 0) {
         int i;
-        for (i  = 0; i < PRO3_SAMPLE_SIZE; i++)
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[PRO3_WAVES - 1][i] = table->ref[0][i];
+        table->isset[PRO3_WAVES - 1] = 1;
+        wavetable_touch(table, PRO3_WAVES - 1);
+    }
+
+    int key[PRO3_WAVES]; /* Indexes of set waveforms */
+    int keys = 0;
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++) if (table->isset[k]) key[keys++] = k;
+
+    int g;
+    for (g = 0; g + 1 < keys; g++)
+    {
+        /* The gap is between keys x1 and x2. x0 and x3 are the keys on either side, for the
+         * spline, or x1 and x2 themselves at the ends.
+         */
+        int x1 = key[g];
+        int x2 = key[g + 1];
+        if (x2 - x1 < 2) continue;
+        int x0 = (g > 0) ? key[g - 1] : x1;
+        int x3 = (g + 2 < keys) ? key[g + 2] : x2;
+        const pcm_sample_t *p[4] = {table->ref[x0], table->ref[x1], table->ref[x2], table->ref[x3]};
+
+        int t;
+        for (t = x1 + 1; t < x2; t++) /* t = target index */
         {
-            table->ref[PRO3_WAVES - 1][i] = table->ref[0][i];
+            float scale = (float) (t - x1) / (x2 - x1);
+            float w[4] = {0, 0, 0, 0};
+            if (mode == PRO3_FILL_COSINE) {
+                _pro3_fill_lerp(p[1], p[2], 0.5f - 0.5f * cosf((float) M_PI * scale), table->ref[t]);
+            } else if (mode == PRO3_FILL_EQUAL_POWER) {
+                w[1] = cosf((float) M_PI * 0.5f * scale);
+                w[2] = sinf((float) M_PI * 0.5f * scale);
+                _pro3_fill_blend(p, w, table->ref[t]);
+            } else if (mode == PRO3_FILL_CUBIC) {
+                /* Hermite basis, with Catmull-Rom tangents scaled for the spacing of the keys */
+                float s2 = scale * scale;
+                float s3 = s2 * scale;
+                float h00 = (2 * s3) - (3 * s2) + 1;
+                float h10 = s3 - (2 * s2) + scale;
+                float h01 = (3 * s2) - (2 * s3);
+                float h11 = s3 - s2;
+                float g1 = (float) (x2 - x1) / (x2 - x0);
+                float g2 = (float) (x2 - x1) / (x3 - x1);
+                w[0] = -h10 * g1;
+                w[1] = h00 - (h11 * g2);
+                w[2] = h01 + (h10 * g1);
+                w[3] = h11 * g2;
+                _pro3_fill_blend(p, w, table->ref[t]);
+            } else {
+                /* Each step is from the waveform before, which gives the same line, rounded as
+                 * wavetable_fill() always has
+                 */
+                _pro3_fill_lerp(table->ref[t - 1], p[2], 1.0f / (x2 - t), table->ref[t]);
+            }
+            wavetable_touch(table, t);
         }
+    }
+}
+
+/* Fill in empty reference waveforms, as wavetable_fill() does, but in Q15 fixed point. The
+ * results are the same on every platform, and are within one LSB of wavetable_fill().
+ */
+void wavetable_fill_fixed(Wavetable *table)
+{
+    if (table->isset[0] == 0) return;
+
+    if (table->isset[PRO3_WAVES - 1] == 0) {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[PRO3_WAVES - 1][i] = table->ref[0][i];
         table->isset[PRO3_WAVES - 1] = 1;
+        wavetable_touch(table, PRO3_WAVES - 1);
     }
 
     int c;
-    for (c = 1; c < 16; c++) /* c = current index */
+    for (c = 1; c < PRO3_WAVES; c++) /* c = current index */
     {
         if (table->isset[c] == 0) {
-            /* There's no waveform here, so it needs to be filled */
             int n;
-            for (n = c; n < 16; n++) /* n = next index */
+            for (n = c; n < PRO3_WAVES && table->isset[n] == 0; n++); /* n = next set index */
+
+            int t;
+            for (t = c; t < n; t++) /* t = target index */
             {
-                if (table->isset[n] == 1) {
-                    /* This is the next set waveform with data, so fill every waveform
-                     * between the current one and this one */
-                    int t;
-                    for (t = c; t < n; t++) /* t = target index */
-                    {
-                        float div = n - c; /* Number of reference waves in range */
-                        float ix = t - c + 1; /* Index of target within the range */
-                        float scale = ix / div;
-                        int i;
-                        for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
-                        {
-                            float pcm_diff = table->ref[n][i] - table->ref[c-1][i];
-                            float v = table->ref[c-1][i] + (pcm_diff * scale);
-                            table->ref[t][i] = (pcm_sample_t) v;
-                        }
-                    }
-                    break;
-                }   
+                pcm_q15_t scale = pcm_q15_ratio(t - c + 1, n - c);
+                pcm_q15_lerp(table->ref[c-1], table->ref[n], table->ref[t], PRO3_SAMPLE_SIZE, scale);
+                wavetable_touch(table, t);
             }
         }
     }
+}
 
-    return;
+/* Fill in empty reference waveforms, as wavetable_fill() does, but by morphing the spectra of
+ * the set waveforms on either side of each gap (see pcm_spectral_morph() in pcm_fft.h). Set
+ * waveforms whose harmonics are out of phase don't cancel out in the middle of the morph. Each
+ * gap is filled with one batch of inverse transforms. If there isn't memory for the transforms,
+ * the gaps are filled linearly instead, so no gap is ever left empty.
+ */
+void wavetable_fill_spectral(Wavetable *table)
+{
+    if (table->isset[0] == 0) return;
+
+    if (table->isset[PRO3_WAVES - 1] == 0) {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++) table->ref[PRO3_WAVES - 1][i] = table->ref[0][i];
+        table->isset[PRO3_WAVES - 1] = 1;
+        wavetable_touch(table, PRO3_WAVES - 1);
+    }
+
+    PCMFFT *fft = pcm_fft_new(PRO3_SAMPLE_SIZE);
+    if (fft == NULL) {
+        wavetable_fill_mode(table, PRO3_FILL_LINEAR);
+        return;
+    }
+
+    int c;
+    for (c = 1; c < PRO3_WAVES; c++) /* c = current index */
+    {
+        if (table->isset[c] == 0) {
+            int n;
+            for (n = c; n < PRO3_WAVES && table->isset[n] == 0; n++); /* n = next set index */
+
+            float scale[PRO3_WAVES];
+            int t;
+            for (t = c; t < n; t++) scale[t - c] = (float) (t - c + 1) / (n - c);
+
+            /* The waves in the gap are consecutive in ref, so they're made in place */
+            if (!pcm_spectral_morph(fft, table->ref[c-1], table->ref[n], scale, n - c, 16, table->ref[c])) {
+                for (t = c; t < n; t++) _pro3_fill_lerp(table->ref[c-1], table->ref[n], scale[t - c], table->ref[t]);
+            }
+            for (t = c; t < n; t++) wavetable_touch(table, t);
+            c = n;
+        }
+    }
+
+    pcm_fft_free(fft);
+}
+
+/* Rotate each set reference waveform so that its cycle starts at the point that best matches the
+ * set waveform before it. Waveforms from different sources seldom start at the same point in
+ * their cycles, and filling between waveforms that are out of line gives hollow, comb-filtered
+ * in-between waves. Do this after setting references and before filling.
+ *
+ * The best match is the peak of the circular cross-correlation of each pair of neighbors, which
+ * is worked out with FFTs. All set waveforms are transformed in one batch, and so are all the
+ * correlations. Each waveform's rotation is the sum of the rotations found between the pairs
+ * before it, so each lines up with its neighbor after that neighbor has been rotated.
+ */
+void wavetable_align(Wavetable *table)
+{
+    int set[PRO3_WAVES]; /* Indexes of set waveforms */
+    int count = 0;
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++) if (table->isset[k]) set[count++] = k;
+    if (count < 2) return;
+
+    PCMFFT *fft = pcm_fft_new(PRO3_SAMPLE_SIZE);
+    float *re = (float *) malloc(sizeof(float) * PRO3_SAMPLE_SIZE * (2 * count - 1));
+    float *im = (float *) malloc(sizeof(float) * PRO3_SAMPLE_SIZE * (2 * count - 1));
+    if (fft == NULL || re == NULL || im == NULL) {
+        pcm_fft_free(fft);
+        free(re);
+        free(im);
+        return;
+    }
+
+    /* Spectra of the set waveforms come first, then the count - 1 correlations */
+    for (k = 0; k < count; k++)
+    {
+        pcm_fft_load(fft, table->ref[set[k]], re + (k * PRO3_SAMPLE_SIZE), im + (k * PRO3_SAMPLE_SIZE));
+    }
+    pcm_fft_forward_batch(fft, re, im, count);
+
+    int i;
+    for (k = 1; k < count; k++)
+    {
+        /* The correlation of the previous waveform p and this one c is the inverse transform
+         * of conj(P) * C. Its peak is the rotation of c that best lines up with p.
+         */
+        float *pre = re + ((k - 1) * PRO3_SAMPLE_SIZE);
+        float *pim = im + ((k - 1) * PRO3_SAMPLE_SIZE);
+        float *cre = re + (k * PRO3_SAMPLE_SIZE);
+        float *cim = im + (k * PRO3_SAMPLE_SIZE);
+        float *xre = re + ((count + k - 1) * PRO3_SAMPLE_SIZE);
+        float *xim = im + ((count + k - 1) * PRO3_SAMPLE_SIZE);
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+        {
+            xre[i] = pre[i] * cre[i] + pim[i] * cim[i];
+            xim[i] = pre[i] * cim[i] - pim[i] * cre[i];
+        }
+    }
+    pcm_fft_inverse_batch(fft, re + (count * PRO3_SAMPLE_SIZE), im + (count * PRO3_SAMPLE_SIZE), count - 1);
+
+    int rotation = 0;
+    for (k = 1; k < count; k++)
+    {
+        float *xre = re + ((count + k - 1) * PRO3_SAMPLE_SIZE);
+        int lag = 0;
+        for (i = 1; i < PRO3_SAMPLE_SIZE; i++) if (xre[i] > xre[lag]) lag = i;
+        rotation = (rotation + lag) % PRO3_SAMPLE_SIZE;
+
+        if (rotation) {
+            pcm_sample_t rotated[PRO3_SAMPLE_SIZE];
+            pcm_sample_t *ref = table->ref[set[k]];
+            for (i = 0; i < PRO3_SAMPLE_SIZE; i++) rotated[i] = ref[(i + rotation) % PRO3_SAMPLE_SIZE];
+            for (i = 0; i < PRO3_SAMPLE_SIZE; i++) ref[i] = rotated[i];
+            wavetable_touch(table, set[k]);
+        }
+    }
+
+    pcm_fft_free(fft);
+    free(re);
+    free(im);
+}
+
+/* Marks waveform num as changed, so that its smaller levels are made again the next time
+ * they're needed, and it's packed again by the next wavetable_sysex_update()
+ */
+void wavetable_touch(Wavetable *table, int num)
+{
+    table->mipset[num] = 0;
+    table->dirty[num] = 1;
+}
+
+/* Returns the 512, 256, and 128-sample levels of waveform num, one after the other. Each level
+ * is made from the one before it with pcm_change_size(), and they're kept until the waveform is
+ * changed, so exporting a table again only works on the waveforms that have changed.
+ */
+const pcm_sample_t *wavetable_mips(Wavetable *table, int num)
+{
+    if (!table->mipset[num]) {
+        PCMData pcm = new_PCMData();
+        set_pcm_data(&pcm, PRO3_SAMPLE_SIZE, table->ref[num]);
+        pcm_sample_t *mip = table->mip[num];
+        pcm_size_t size;
+        for (size = PRO3_SAMPLE_SIZE / 2; size >= PRO3_SAMPLE_SIZE / 8; size /= 2)
+        {
+            pcm_change_size(&pcm, size);
+            pcm_index_t i;
+            for (i = 0; i < size; i++) mip[i] = pcm.data[i];
+            mip += size;
+        }
+        table->mipset[num] = 1;
+    }
+    return table->mip[num];
+}
+
+/* Pro3Packer turns 16-bit words into packed system exclusive as they come, keeping the
+ * checksum on the way. A packet's first byte (the high bits of the next seven bytes) goes at
+ * head, and is filled in when the packet is done.
+ */
+typedef struct _PRO3_PACKER {
+    unsigned char *out; /* Where the next byte goes */
+    unsigned char *head; /* The current packet's first byte */
+    int packbyte; /* High bits of the current packet so far */
+    int pos; /* Bytes in the current packet so far */
+    uint32_t checksum;
+} Pro3Packer;
+
+/* Packs one byte, without adding it to the checksum */
+void _pro3_pack_byte(Pro3Packer *packer, unsigned char c)
+{
+    if (packer->pos == 0) {
+        packer->head = packer->out++;
+        packer->packbyte = 0;
+    }
+    packer->packbyte |= (c >> 7) << packer->pos;
+    *(packer->out++) = c & 0x7f;
+    if (++packer->pos == 7) {
+        *(packer->head) = packer->packbyte;
+        packer->pos = 0;
+    }
+}
+
+/* Packs the bytes of size words, big-endian, and adds the words (with their bytes swapped) to
+ * the checksum. When a packet is starting, each run of seven words makes two whole packets, so
+ * most of the data skips the byte-at-a-time path.
+ */
+void _pro3_pack_words(Pro3Packer *packer, const pcm_sample_t words[], unsigned long size)
+{
+    unsigned long i = 0;
+    uint32_t checksum = 0;
+    while (i < size)
+    {
+        if (packer->pos == 0 && i + 7 <= size) {
+            unsigned char *out = packer->out; /* Kept local, since stores through it may alias */
+            for (; i + 7 <= size; i += 7)
+            {
+                uint64_t w[7]; /* Each word with its bytes swapped, so the high byte is first */
+                int j;
+                for (j = 0; j < 7; j++)
+                {
+                    uint16_t word = (uint16_t) (int16_t) words[i + j];
+                    w[j] = (uint16_t) ((word >> 8) | (word << 8));
+                    checksum += w[j];
+                }
+
+                /* The seven words are fourteen bytes, high byte first. The first packet holds
+                 * words 0-2 and the high byte of word 3, and the second holds the low byte of
+                 * word 3 and words 4-6. Each packet's bytes are gathered into a 64-bit value,
+                 * first byte lowest.
+                 */
+                unsigned char packets[16];
+                uint64_t x[2];
+                x[0] = w[0] | (w[1] << 16) | (w[2] << 32) | ((w[3] & 0xff) << 48);
+                x[1] = (w[3] >> 8) | (w[4] << 8) | (w[5] << 24) | (w[6] << 40);
+                for (j = 0; j < 2; j++)
+                {
+                    /* Multiplying moves the high bit of byte b (bit 8b + 7, shifted down to
+                     * 8b) up to bit 56 + b, without any of the partial products overlapping.
+                     */
+                    uint64_t high = (((x[j] >> 7) & 0x01010101010101ULL) * 0x0102040810204000ULL) >> 56;
+                    uint64_t packet = ((x[j] & 0x7f7f7f7f7f7f7fULL) << 8) | high;
+                    int b;
+                    for (b = 0; b < 8; b++) packets[(j * 8) + b] = (unsigned char) (packet >> (8 * b));
+                }
+                memcpy(out, packets, 16);
+                out += 16;
+            }
+            packer->out = out;
+            continue;
+        }
+
+        uint16_t w = (uint16_t) (int16_t) words[i++];
+        checksum += (uint16_t) ((w >> 8) | (w << 8));
+        _pro3_pack_byte(packer, w >> 8);
+        _pro3_pack_byte(packer, w & 0xff);
+    }
+    packer->checksum += checksum;
+}
+
+/* Writes the 17 bytes of header, wavetable number, and name that start a message. The name is
+ * padded with spaces to 8 characters.
+ */
+void _pro3_sysex_header(unsigned char sysex[], int num, const char *name)
+{
+    unsigned long size = 0;
+    sysex[size++] = 0xf0; /* Start SysEx */
+    sysex[size++] = 0x01; /* DSI */
+    sysex[size++] = 0x31; /* Pro3 */
+    sysex[size++] = 0x6a;
+    sysex[size++] = 0x6c;
+    sysex[size++] = 0x01;
+    sysex[size++] = 0x6b;
+    sysex[size++] = num;
+    int c;
+    int length = strlen(name);
+    for (c = 0; c < 8; c++) sysex[size++] = (c < length) ? name[c] : ' '; /* Enforce 8 characters */
+    sysex[size++] = 0x00;
+}
+
+/* Packs waveform k: the full waveform, then the 512-word level once, the 256-word level twice,
+ * and the 128-word level eight times
+ */
+void _pro3_pack_wave(Pro3Packer *packer, Wavetable *table, int k)
+{
+    const pcm_sample_t *level = wavetable_mips(table, k);
+    _pro3_pack_words(packer, table->ref[k], PRO3_SAMPLE_SIZE);
+    int l;
+    for (l = 1; l < 4; l++)
+    {
+        unsigned long level_size = PRO3_SAMPLE_SIZE >> l;
+        int j;
+        for (j = 0; j < PRO3_LEVEL_REPEAT(l); j++) _pro3_pack_words(packer, level, level_size);
+        level += level_size;
+    }
 }
 
+/* Builds the whole message, as wavetable_sysex() does, and puts each waveform's part of the
+ * checksum into sum[], if it isn't NULL
+ */
+unsigned long _pro3_sysex_build(Wavetable *table, int num, const char *name, unsigned char sysex[], uint16_t sum[])
+{
+    _pro3_sysex_header(sysex, num, name);
+
+    Pro3Packer packer;
+    packer.out = sysex + 17;
+    packer.head = packer.out;
+    packer.packbyte = 0;
+    packer.pos = 0;
+    packer.checksum = 0;
+
+    int k;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        uint32_t before = packer.checksum;
+        _pro3_pack_wave(&packer, table, k);
+        if (sum != NULL) sum[k] = (uint16_t) (packer.checksum - before);
+    }
+
+    /* Finish the last packet, which is short */
+    if (packer.pos) *(packer.head) = packer.packbyte;
+    unsigned long size = packer.out - sysex;
+
+    uint16_t checksum = (uint16_t) packer.checksum;
+    sysex[size++] = checksum & 0x7f;
+    sysex[size++] = (checksum >> 8) & 0x7f;
+    sysex[size++] = 0xf7; /* End SysEx */
+    return size;
+}
+
+/* Builds the system exclusive message for a Wavetable in sysex[], which needs room for
+ * PRO3_SYSEX_SIZE bytes, and returns its size. The name is padded with spaces to 8 characters.
+ * Nothing is shared between calls, so separate Wavetables can be built on separate threads.
+ *
+ * Each level of each waveform goes straight from the Wavetable into packed 7-bit data (the same
+ * data that Seq_pack() would make from the big-endian bytes), and the checksum is kept on the
+ * way, so the data is only gone through once.
+ */
+unsigned long wavetable_sysex(Wavetable *table, int num, const char *name, unsigned char sysex[])
+{
+    return _pro3_sysex_build(table, num, name, sysex, NULL);
+}
+
+/*
+ * Brings the message in a Pro3SysexImage up to date with a Wavetable, and returns its size. The
+ * first time, the whole message is built. After that, only the waveforms that have changed since
+ * the last update (see wavetable_touch()) are packed again, into the packets that hold them.
+ *
+ * Each waveform is 6144 bytes before packing, which isn't a whole number of 7-byte packets, so
+ * a waveform can start and end partway through a packet. The packer is started where the
+ * waveform starts, with the high bits already in that packet's first byte, and at the end, the
+ * high bits of the bytes after the waveform are put back. The checksum is a plain 16-bit sum, so
+ * it's made again from each waveform's part, and only the changed parts are worked out.
+ *
+ * The header is written each time, so the number and name can change. The table's waveforms are
+ * marked as packed.
+ */
+unsigned long wavetable_sysex_update(Wavetable *table, int num, const char *name, Pro3SysexImage *image)
+{
+    int k;
+    if (image->size == 0) {
+        image->size = _pro3_sysex_build(table, num, name, image->sysex, image->sum);
+        for (k = 0; k < PRO3_WAVES; k++) table->dirty[k] = 0;
+        return image->size;
+    }
+
+    _pro3_sysex_header(image->sysex, num, name);
+    unsigned char *data = image->sysex + 17;
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        if (!table->dirty[k]) continue;
+        unsigned long start = (unsigned long) k * (PRO3_DATA_SIZE / PRO3_WAVES); /* In unpacked bytes */
+        int pos = start % 7;
+        Pro3Packer packer;
+        packer.head = data + ((start / 7) * 8);
+        packer.out = pos ? packer.head + 1 + pos : packer.head;
+        packer.packbyte = *(packer.head) & ((1 << pos) - 1);
+        packer.pos = pos;
+        packer.checksum = 0;
+        _pro3_pack_wave(&packer, table, k);
+        if (packer.pos) *(packer.head) = packer.packbyte | (*(packer.head) & (0x7f << packer.pos) & 0x7f);
+        image->sum[k] = (uint16_t) packer.checksum;
+        table->dirty[k] = 0;
+    }
+
+    uint16_t checksum = 0;
+    for (k = 0; k < PRO3_WAVES; k++) checksum += image->sum[k];
+    image->sysex[image->size - 3] = checksum & 0x7f;
+    image->sysex[image->size - 2] = (checksum >> 8) & 0x7f;
+    return image->size;
+}
+
+/* Sends a Wavetable to standard output as system exclusive */
 void wavetable_sysex_dump(Wavetable *table, int num, char *name)
 {
-    /* PCM data is signed, while the dsi_packing tools require data to be unsigned. So,
-     * conversion must be done. First, I cast each sample to an int16_t to guarantee that
-     * it's a 16-bit signed integer. Then, I divide the 16-bit word into bytes and
-     * place them, big-endian, into an pro3 data array.
+    static unsigned char sysex[PRO3_SYSEX_SIZE];
+    while (strlen(name) < 8) strcat(name, " "); /* Enforce 8 characters */
+    unsigned long size = wavetable_sysex(table, num, name, sysex);
+    fwrite(sysex, 1, size, stdout);
+}
+
+/* Returns the checksum of unpacked wavetable data: the sum of its 16-bit words with their bytes
+ * swapped. Even and odd bytes are summed separately, with no dependency between one word and the
+ * next, so the compiler can vectorize the loop.
+ */
+uint16_t _pro3_checksum(const unsigned char data[], unsigned long size)
+{
+    uint32_t even = 0;
+    uint32_t odd = 0;
+    unsigned long i;
+    for (i = 0; i + 1 < size; i += 2)
+    {
+        even += data[i];
+        odd += data[i + 1];
+    }
+    return (uint16_t) (even + (odd << 8));
+}
+
+/* Reads a wavetable system exclusive message, in the form that wavetable_sysex_dump() sends,
+ * into a Wavetable. Each waveform's full 1024-sample level is loaded, and all 16 are marked as
+ * set. The smaller levels in the message are kept as the waveforms' cached levels (see
+ * wavetable_mips()), so a loaded table is exported again just as it was. If check_mips is
+ * nonzero, they're first checked against levels made from the full waveforms.
+ *
+ * The zero-indexed wavetable number is put into num, and the name, without its padding, into
+ * name[], which needs room for 9 characters. Either may be NULL.
+ *
+ * Returns PRO3_SYSEX_OK, or one of the PRO3_SYSEX_BAD_ results, in which case the Wavetable is
+ * left as it was (except for PRO3_SYSEX_BAD_MIPS, where the table is loaded and the cached
+ * levels are the ones made from the full waveforms).
+ */
+int wavetable_sysex_load(Wavetable *table, const unsigned char sysex[], unsigned long size, int *num, char name[],
+                         int check_mips)
+{
+    const unsigned char header[] = {0xf0, 0x01, 0x31, 0x6a, 0x6c, 0x01, 0x6b};
+    if (size < 17 || memcmp(sysex, header, sizeof(header))) return PRO3_SYSEX_BAD_HEADER;
+    if (size != PRO3_SYSEX_SIZE || sysex[size - 1] != 0xf7) return PRO3_SYSEX_BAD_SIZE;
+
+    unsigned char data[PRO3_DATA_SIZE + 7];
+    long packed_size = size - 17 - 3; /* Less the header and name, checksum, and F7 */
+    if (Seq_unpack_bytes(sysex + 17, packed_size, data) != PRO3_DATA_SIZE) return PRO3_SYSEX_BAD_SIZE;
+    uint16_t checksum = _pro3_checksum(data, PRO3_DATA_SIZE);
+    if ((checksum & 0x7f) != sysex[size - 3] || ((checksum >> 8) & 0x7f) != sysex[size - 2]) {
+        return PRO3_SYSEX_BAD_CHECKSUM;
+    }
+
+    if (num != NULL) *num = sysex[7];
+    if (name != NULL) {
+        memcpy(name, sysex + 8, 8);
+        int c;
+        for (c = 8; c > 0 && name[c - 1] == ' '; c--);
+        name[c] = '\0';
+    }
+
+    /* Each waveform is 1024 words of the full level, then the 512, 256, and 128-word levels,
+     * with the smaller levels repeated (see wavetable_sysex()). Only the first copy of each
+     * smaller level is kept.
      */
-    unsigned int pro3_data[PCM_MAX];
-    unsigned long int i; /* i is the index within the PCM data */
-    unsigned long int dx = 0; /* dx is the index within the Pro 3 data */    
-    uint16_t checksum = 0;
-    
+    const unsigned char *wave = data;
+    int bad_mips = 0;
     int k;
-    for (k = 0; k < 16; k++)
-    {
-	    PCMData pcm = new_PCMData();
-        set_pcm_data(&pcm, PRO3_SAMPLE_SIZE, table->ref[k]);
-	    
-	    for (i = 0; i < pcm.size; i++)
-	    {
-	    	int16_t sample = (int16_t)pcm.data[i];
-	
-	        /* Convert the signed 16-bit sample into a high and low byte */
-	        pro3_data[dx++] = (sample) >> 8; /* High byte */
-	        pro3_data[dx++] = (sample) & 0xff; /* Low byte */
-	        uint16_t check = (((uint16_t) sample >> 8) | ((uint16_t) sample << 8));
-	        checksum += check;
-	    }	    
-	    
-	    /* Downsample to a 512-word waveform */
-	    pcm_change_size(&pcm, PRO3_SAMPLE_SIZE / 2);
-	    for (i = 0; i < pcm.size; i++)
-	    {
-	    	int16_t sample = (int16_t)pcm.data[i];
-	        pro3_data[dx++] = (sample) >> 8; /* High byte */
-	        pro3_data[dx++] = (sample) & 0xff; /* Low byte */
-	        uint16_t check = (((uint16_t) sample >> 8) | ((uint16_t) sample << 8));
-	        checksum += check;
-	    }
-	    
-	    /* Downsample to a 256-word waveform and add it twice */
-	    pcm_change_size(&pcm, PRO3_SAMPLE_SIZE / 4);
-	    int j;
-	    for (j = 0; j < 2; j++) 
-	    {
-		    for (i = 0; i < pcm.size; i++)
-		    {
-		    	int16_t sample = (int16_t)pcm.data[i];
-		        pro3_data[dx++] = (sample) >> 8; /* High byte */
-		        pro3_data[dx++] = (sample) & 0xff; /* Low byte */
-	            uint16_t check = (((uint16_t) sample >> 8) | ((uint16_t) sample << 8));
-	            checksum += check;
-		    }
-		}
-	    
-	    /* Downsample to a 128-word waveform and add it eight times */
-	    pcm_change_size(&pcm, PRO3_SAMPLE_SIZE / 8);
-	    for (j = 0; j < 8; j++) 
-	    {
-		    for (i = 0; i < pcm.size; i++)
-		    {
-		    	int16_t sample = (int16_t)pcm.data[i];
-		        pro3_data[dx++] = (sample) >> 8; /* High byte */
-		        pro3_data[dx++] = (sample) & 0xff; /* Low byte */
-    	        uint16_t check = (((uint16_t) sample >> 8) | ((uint16_t) sample << 8));
-	            checksum += check;
-		    }
-		}		
-	}
-	
-    /* Use dsi_packing tools to convert the sample data into DSI's packed format */
-    UnpackedData pro3_wavetable;
-    Seq_set(&pro3_wavetable, dx, pro3_data);
-    PackedData pro3_sysex = Seq_pack(pro3_wavetable);
-  
-    /* Send the actual SysEx to standard output */
-    putchar(0xf0); /* Start SysEx */
-    putchar(0x01); /* DSI */
-    putchar(0x31); /* Pro3 */
-    putchar(0x6a);
-    putchar(0x6c);
-    putchar(0x01);
-    putchar(0x6b);
-    putchar(num);
-    while (strlen(name) < 8) strcat(name, " "); /* Enforce 8 characters */
-    printf("%.8s", name);
-    putchar(0x00);
-    Seq_dump(pro3_sysex);
-    putchar((char) (checksum & 0x7f));
-    putchar((char) (checksum >> 8) & 0x7f);
-    putchar(0xf7); /* End SysEx */
+    for (k = 0; k < PRO3_WAVES; k++)
+    {
+        int i;
+        for (i = 0; i < PRO3_SAMPLE_SIZE; i++)
+        {
+            table->ref[k][i] = (int16_t) ((wave[2 * i] << 8) | wave[2 * i + 1]);
+        }
+        table->isset[k] = 1;
+        wavetable_touch(table, k);
+
+        pcm_sample_t stored[PRO3_MIP_SIZE];
+        const unsigned char *level = wave + (2 * PRO3_SAMPLE_SIZE);
+        int mx = 0; /* Index within stored */
+        int l;
+        for (l = 1; l < 4; l++)
+        {
+            int level_size = PRO3_SAMPLE_SIZE >> l;
+            for (i = 0; i < level_size; i++)
+            {
+                stored[mx++] = (int16_t) ((level[2 * i] << 8) | level[2 * i + 1]);
+            }
+            level += 2 * level_size * PRO3_LEVEL_REPEAT(l);
+        }
+        wave = level;
+
+        if (check_mips && memcmp(stored, wavetable_mips(table, k), sizeof(stored))) {
+            bad_mips = 1;
+        } else {
+            memcpy(table->mip[k], stored, sizeof(stored));
+            table->mipset[k] = 1;
+        }
+    }
+
+    return bad_mips ? PRO3_SYSEX_BAD_MIPS : PRO3_SYSEX_OK;
 }
 
 void wavetable_pcm_dump(Wavetable *table)
@@ -219,6 +942,8 @@ void wavetable_pcm_dump(Wavetable *table)
     }
 }
 
+#endif /* PRO3_WAVETABLE_H_ */
+
 /*
  * Copyright (c) 2020 The Beige Maze Project
  *
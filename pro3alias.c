@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* pro3alias measures the aliasing in the smaller levels of exported Pro 3 wavetables (see
+ * pro3_alias.h). Each file can hold one wavetable system exclusive message, or many end to end,
+ * as pro3_bank_write() makes them, and every message is measured, with the levels just as they
+ * were exported. A report is printed for each table, and with a threshold, a summary of the
+ * tables that are worse than it; the exit status is 1 if there are any, so a nightly export can
+ * fail on a regression.
+ *
+ *   pro3alias Table.syx
+ *   pro3alias -t -30 Nightly.syx Tables.syx
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pro3_alias.h"
+
+int main(int argc, char *argv[])
+{
+    int first = 1;
+    int check = 0;
+    float threshold = 0;
+    if (argc > 2 && !strcmp(argv[1], "-t")) {
+        check = 1;
+        threshold = atof(argv[2]);
+        first = 3;
+    }
+    if (first >= argc) {
+        printf("\nusage: %s [-t threshold_db] file.syx ...\n\n", argv[0]);
+        return -1;
+    }
+
+    Pro3Alias *analyzer = pro3_alias_new();
+    Wavetable *table = (Wavetable *) malloc(sizeof(Wavetable));
+    unsigned char *sysex = (unsigned char *) malloc(PRO3_SYSEX_SIZE);
+    if (analyzer == NULL || table == NULL || sysex == NULL) return -1;
+
+    int tables = 0;
+    int failed = 0;
+    int a;
+    for (a = first; a < argc; a++)
+    {
+        FILE *file = fopen(argv[a], "rb");
+        if (file == NULL) {
+            fprintf(stderr, "%s: can't open\n", argv[a]);
+            failed++;
+            continue;
+        }
+        int message = 0;
+        unsigned long size;
+        while ((size = fread(sysex, 1, PRO3_SYSEX_SIZE, file)) > 0)
+        {
+            message++;
+            *table = new_Wavetable();
+            int num;
+            char name[9];
+            int result = wavetable_sysex_load(table, sysex, size, &num, name, 0);
+            if (result != PRO3_SYSEX_OK) {
+                fprintf(stderr, "%s: message %d isn't a good Pro 3 wavetable (error %d)\n", argv[a], message, result);
+                failed++;
+                break;
+            }
+
+            Pro3AliasReport report;
+            pro3_alias_analyze(analyzer, table, &report);
+            char label[4096];
+            snprintf(label, sizeof(label), "%s #%d \"%s\" (wavetable %d)", argv[a], message, name, num + 1);
+            pro3_alias_print(&report, label, stdout);
+            tables++;
+            if (check && report.worst > threshold) {
+                fprintf(stderr, "%s: worst %.1f dB is over %.1f dB\n", label, report.worst, threshold);
+                failed++;
+            }
+        }
+        fclose(file);
+    }
+
+    if (check) fprintf(stderr, "%d table(s) measured, %d failed\n", tables, failed);
+    free(sysex);
+    free(table);
+    pro3_alias_free(analyzer);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* pro3render plays a Pro 3 wavetable system exclusive file (as made by raw2pro3 or
+ * stream2pro3) as an oscillator, and writes the audio to standard output as a 16-bit
+ * mono WAV file at 44.1 kHz. The morph position moves from start to end over the length
+ * of the note. With more than one voice, the voices are spread over a few cents, and
+ * mixed. The time it took, in voices per core, is reported on standard error.
+ *
+ *   pro3render Table.syx 110 4 0 15 > sweep.wav
+ *   pro3render Table.syx 220 10 0 15 64 > /dev/null
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "pcm_stream.h"
+#include "pro3_render.h"
+
+#define RENDER_RATE 44100
+#define RENDER_RESOLUTION 16
+#define RENDER_BLOCK 4096
+#define DETUNE_CENTS 12 /* Spread of the voices, from lowest to highest */
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        printf("\nusage: %s wavetable.syx frequency seconds [start_position end_position] [voices]\n\n", argv[0]);
+        return -1;
+    }
+    float frequency = atof(argv[2]);
+    float seconds = atof(argv[3]);
+    float start = (argc > 5) ? atof(argv[4]) : 0;
+    float end = (argc > 5) ? atof(argv[5]) : PRO3_WAVES - 1;
+    int voices = (argc > 6) ? atoi(argv[6]) : 1;
+    if (frequency <= 0 || frequency >= RENDER_RATE / 2 || seconds <= 0 || voices < 1) {
+        printf("\nfrequency, seconds, or voices out of range\n\n");
+        return -1;
+    }
+
+    /* Read the wavetable */
+    static unsigned char sysex[PRO3_SYSEX_SIZE + 1];
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        printf("\ncan't open %s\n\n", argv[1]);
+        return -1;
+    }
+    unsigned long size = fread(sysex, 1, sizeof(sysex), file);
+    fclose(file);
+    static Wavetable table;
+    table = new_Wavetable();
+    int result = wavetable_sysex_load(&table, sysex, size, NULL, NULL, 0);
+    if (result != PRO3_SYSEX_OK) {
+        printf("\n%s isn't a good Pro 3 wavetable (error %d)\n\n", argv[1], result);
+        return -1;
+    }
+
+    Pro3RenderTable *render = pro3_render_table_new(&table);
+    Pro3Voice *voice = (Pro3Voice *) malloc(sizeof(Pro3Voice) * voices);
+    if (render == NULL || voice == NULL) return -1;
+    Pro3Envelope envelope = pro3_envelope(start, end, seconds);
+    int v;
+    for (v = 0; v < voices; v++)
+    {
+        float cents = (voices > 1) ? (DETUNE_CENTS * v / (float) (voices - 1)) - (DETUNE_CENTS / 2.0f) : 0;
+        voice[v] = pro3_voice_new(render, frequency * powf(2, cents / 1200), RENDER_RATE, envelope, 0.5f / sqrtf(voices));
+    }
+
+    WAVWriter wav;
+    if (!wav_writer_open(&wav, stdout, 1, RENDER_RESOLUTION, RENDER_RATE)) return -1;
+    static float mix[RENDER_BLOCK];
+    static pcm_sample_t pcm[RENDER_BLOCK];
+    pcm_offset_t frames = (pcm_offset_t) (seconds * RENDER_RATE);
+    double busy = 0; /* Seconds spent rendering, not counting output */
+    pcm_offset_t done = 0;
+    while (done < frames)
+    {
+        pcm_size_t block = (frames - done > RENDER_BLOCK) ? RENDER_BLOCK : (pcm_size_t) (frames - done);
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t0);
+        memset(mix, 0, sizeof(float) * block);
+        for (v = 0; v < voices; v++) pro3_voice_render(&voice[v], mix, block);
+        pro3_render_quantize(mix, pcm, block, RENDER_RESOLUTION);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+        busy += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        if (!wav_writer_write(&wav, pcm, block)) return -1;
+        done += block;
+    }
+    wav_writer_close(&wav);
+
+    /* A voice rendered for seconds of audio in busy seconds could have been one of
+     * seconds / busy voices running in real time on this core
+     */
+    double speed = (busy > 0) ? seconds / busy : 0;
+    fprintf(stderr, "%d voice(s) at %.2f Hz (level %d), %.2f s in %.3f s of CPU: %.1fx real time, %.0f voices per core\n",
+            voices, frequency, voice[0].level, seconds, busy, speed, speed * voices);
+
+    free(voice);
+    pro3_render_table_free(render);
+    return 0;
+}
@@ -27,7 +27,7 @@
  * byte in each packet is a composite of the high bits of the next seven data
  * bytes.
  *
- * Four functions are provided in this header:
+ * Six functions are provided in this header:
  *
  * Seq_unpack() converts a single Sequential system exclusive dump values 
  * into a series of data bytes, so that the values may be freely manipulated
@@ -41,6 +41,11 @@
  *
  * Seq_dump() sends the values to standard output.
  *
+ * Seq_pack_bytes() and Seq_unpack_bytes() do what Seq_pack() and Seq_unpack()
+ * do, but from one byte array straight into another.  They don't need a
+ * SequentialData, so they have no size limit, and they're much faster for
+ * large dumps, like wavetables.
+ *
  */
 #ifndef SEQUENTIAL_PACKING_H_
 #include <stdio.h>
@@ -63,6 +68,8 @@ UnpackedData Seq_unpack(PackedData packed);
 PackedData Seq_pack(UnpackedData unpacked);
 void Seq_set(SequentialData *voice, int size, unsigned int values[]);
 void Seq_dump(SequentialData voice);
+long Seq_pack_bytes(const unsigned char unpacked[], long size, unsigned char packed[]);
+long Seq_unpack_bytes(const unsigned char packed[], long size, unsigned char unpacked[]);
 
 /*
  * Given packed data (for example, the data that would come directly from a
@@ -192,4 +199,67 @@ void Seq_dump(SequentialData data)
     for (i = 0; i < data.size; i++) putchar(data.value[i]);
 }
 
+/*
+ * Packs size bytes of unpacked data into packed[], and returns the packed 
+ * size.  The result is the same as Seq_pack()'s.  packed[] needs room for 
+ * ((size / 7) * 8) + 8 bytes.
+ *
+ * Example:
+ *
+ *   unsigned char packed[SIZE_OF_DATA + (SIZE_OF_DATA / 7) + 8];
+ *   long packed_size = Seq_pack_bytes(data, SIZE_OF_DATA, packed);
+ *   fwrite(packed, 1, packed_size, stdout);
+ */
+long Seq_pack_bytes(const unsigned char unpacked[], long size, unsigned char packed[])
+{
+    long ixu = 0;      /* Unpacked byte index */
+    long ixp = 0;      /* Packed byte index */
+    int i;
+    
+    /* Each whole packet of 7 bytes, but the last one */
+    for (; ixu + 7 < size; ixu += 7)
+    {
+        unsigned char packbyte = 0;
+        for (i = 0; i < 7; i++) 
+        {
+            packbyte |= (unpacked[ixu + i] >> 7) << i;
+            packed[ixp + 1 + i] = unpacked[ixu + i] & 0x7f;
+        }
+        packed[ixp] = packbyte;
+        ixp += 8;
+    }
+    
+    /* The last packet, which may be short (or empty, if size is 0) */
+    unsigned char packbyte = 0;
+    for (i = 0; ixu + i < size; i++)
+    {
+        packbyte |= (unpacked[ixu + i] >> 7) << i;
+        packed[ixp + 1 + i] = unpacked[ixu + i] & 0x7f;
+    }
+    packed[ixp] = packbyte;
+    return ixp + 1 + i;
+}
+
+
+/*
+ * Unpacks size bytes of packed data into unpacked[], and returns the unpacked
+ * size.  The result is the same as Seq_unpack()'s.  unpacked[] needs room for 
+ * ((size / 8) * 7) + 7 bytes.
+ */
+long Seq_unpack_bytes(const unsigned char packed[], long size, unsigned char unpacked[])
+{
+    long ixp;          /* Packed byte index */
+    long ixu = 0;      /* Unpacked byte index */
+    for (ixp = 0; ixp < size; ixp += 8)
+    {
+        unsigned char packbyte = packed[ixp];
+        int i;
+        for (i = 0; i < 7 && ixp + 1 + i < size; i++)
+        {
+            unpacked[ixu++] = packed[ixp + 1 + i] | (((packbyte >> i) & 1) << 7);
+        }
+    }
+    return ixu;
+}
+
 #endif /* SEQUENTIAL_PACKING_H_ */
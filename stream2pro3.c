@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* stream2pro3 captures 16-bit raw PCM from standard input (for example, from
+ * arecord -f cd -t raw) and keeps the most recent audio in a ring buffer. Each time
+ * the process gets SIGUSR1, the most recent second of audio is snapshotted and
+ * turned into a Pro 3 wavetable, which is sent to standard output as system
+ * exclusive. Capture goes on while this happens. When standard input ends, one last
+ * wavetable is made from the end of the audio.
+ *
+ *   arecord -f cd -t raw | stream2pro3 Live 33 > live.syx &
+ *   kill -USR1 %1
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "pcm_stream.h"
+#include "pcm_mix.h"
+#include "pro3_wavetable.h"
+
+#define CAPTURE_RATE 44100
+#define CAPTURE_RESOLUTION 16
+#define RING_FRAMES (CAPTURE_RATE * 8) /* Keep the last several seconds */
+#define SNAPSHOT_FRAMES CAPTURE_RATE /* Make each wavetable from the last second */
+
+/* State shared by the capture thread and the main thread */
+typedef struct _Capture {
+    PCMRing *ring;
+    pthread_t main_thread;
+} Capture;
+
+/* The capture thread reads blocks from standard input into the ring until the input
+ * ends, and then lets the main thread know with SIGUSR2.
+ */
+void *capture(void *arg)
+{
+    Capture *cap = (Capture *) arg;
+    static pcm_sample_t block[PCM_STREAM_BLOCK * PCM_STREAM_MAX_CHANNELS];
+    for (;;)
+    {
+        pcm_size_t frames = pcm_read_block(stdin, block, PCM_STREAM_BLOCK, cap->ring->channels, CAPTURE_RESOLUTION);
+        if (frames) pcm_ring_write(cap->ring, block, frames);
+        if (frames < PCM_STREAM_BLOCK) break;
+    }
+    pthread_kill(cap->main_thread, SIGUSR2);
+    return NULL;
+}
+
+/* Makes a wavetable from the most recent audio in the ring and sends it to standard output */
+void snapshot(PCMRing *ring, pcm_size_t cycle, int num, const char *name)
+{
+    static PCMData recent;
+    static PCMData mono;
+    static Wavetable table;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    recent = new_PCMData();
+    recent.channels = ring->channels;
+    recent.rate = ring->rate;
+    recent.size = pcm_ring_snapshot(ring, recent.data, SNAPSHOT_FRAMES);
+    if (recent.size < cycle) return;
+
+    pcm_mix_down(pcm_slice_of(&recent), &mono);
+    table = new_Wavetable();
+    wavetable_from_slice(&table, pcm_slice_of(&mono), cycle);
+
+    char table_name[9]; /* wavetable_sysex_dump() pads the name to 8 characters */
+    strncpy(table_name, name, 8);
+    table_name[8] = '\0';
+    wavetable_sysex_dump(&table, num, table_name);
+    fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    fprintf(stderr, "wavetable %d from %lu frames in %.2f ms\n", num + 1, recent.size, ms);
+}
+
+int main(int argc, char *argv[])
+{
+    /* The wavetable name and number are expected as command-line arguments */
+    if (argc < 3) {
+        printf("\nusage: %s wavetable_name wavetable_number [cycle_length] [channels]\n\n", argv[0]);
+        return -1;
+    }
+    int wavetable_number = atoi(argv[2]);
+    if (wavetable_number > 64 || wavetable_number < 33) {
+        printf("\nwavetable number out of range (33-64)\n\n");
+        return -1;
+    }
+    wavetable_number--; /* Because wavetable numbers are zero-indexed to the Pro3 */
+    pcm_size_t cycle = (argc > 3) ? atol(argv[3]) : PRO3_SAMPLE_SIZE;
+    int channels = (argc > 4) ? atoi(argv[4]) : 2;
+    if (cycle < 2 || cycle > SNAPSHOT_FRAMES || channels < 1 || channels > 2) {
+        printf("\ncycle length (2-%d) or channels (1-2) out of range\n\n", SNAPSHOT_FRAMES);
+        return -1;
+    }
+
+    /* Only the main thread takes signals, and it takes them with sigwait(), so block them
+     * here before the capture thread starts (and inherits the mask).
+     */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    Capture cap;
+    cap.ring = pcm_ring_new(RING_FRAMES, channels, CAPTURE_RESOLUTION, CAPTURE_RATE);
+    cap.main_thread = pthread_self();
+    if (cap.ring == NULL) return -1;
+    pthread_t capture_thread;
+    if (pthread_create(&capture_thread, NULL, capture, &cap)) return -1;
+
+    for (;;)
+    {
+        int sig;
+        sigwait(&signals, &sig);
+        if (sig == SIGUSR1 || sig == SIGUSR2) snapshot(cap.ring, cycle, wavetable_number, argv[1]);
+        if (sig != SIGUSR1) break;
+    }
+
+    pthread_cancel(capture_thread);
+    pthread_join(capture_thread, NULL);
+    pcm_ring_free(cap.ring);
+    return 0;
+}
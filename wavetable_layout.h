@@ -0,0 +1,271 @@
+/* Wavetable Layout (wavetable_layout.h)
+ *
+ * Describes how a synth wants a wavetable sent, so that one serializer can build the message for
+ * any synth whose layout can be described. A WavetableLayout gives:
+ *
+ *   - the number of frames sent, taken evenly from a Wavetable's 16 waveforms
+ *   - the mip schedule: how many levels (1024, 512, 256, and 128 samples) are sent, and how many
+ *     times each one is repeated
+ *   - the byte order of the 16-bit samples
+ *   - how the bytes are packed into 7-bit system exclusive data
+ *   - a header template, and where the wavetable number and name go in it
+ *   - the checksum rule, and a footer
+ *
+ * wavetable_layout_valid() checks that a layout's values are in range. A layout that isn't valid
+ * builds nothing, rather than reading past the ends of its arrays.
+ *
+ * Layouts are meant to be static const, so they're known when a target's serializer is compiled.
+ * WAVETABLE_LAYOUT_SERIALIZER() defines a function for a layout, which the compiler can build with
+ * the layout's values folded in. The data goes straight from the Wavetable into packed data, with
+ * the checksum kept on the way, as wavetable_sysex() does. When a layout sends big-endian samples
+ * in Sequential packing, the fast path of wavetable_sysex() is used, seven words at a time.
+ *
+ * PRO3_LAYOUT is the Pro 3's layout, and pro3_layout_sysex() makes the same bytes as
+ * wavetable_sysex().
+ *
+ * wavetable_layout_valid() checks a layout.
+ *
+ * wavetable_layout_size() returns the size of a layout's message.
+ *
+ * wavetable_layout_build() builds a message for any layout.
+ *
+ * Please see the bottom for boring license information.
+ */
+
+#ifndef WAVETABLE_LAYOUT_H_
+#include <stdint.h>
+#include <string.h>
+#include "pro3_wavetable.h"
+#define WAVETABLE_LAYOUT_H_
+
+/* The most levels a layout can send: 1024, 512, 256, and 128 samples */
+#define WAVETABLE_LAYOUT_LEVELS 4
+
+/* How bytes are packed */
+#define WAVETABLE_PACK_NONE 0 /* As they are, for files rather than system exclusive */
+#define WAVETABLE_PACK_SEQUENTIAL 1 /* Seven bytes in eight, high bits first (see Seq_pack()) */
+#define WAVETABLE_PACK_NIBBLES 2 /* Each byte as two, high four bits first */
+
+/* How the checksum is worked out from the unpacked bytes, and sent */
+#define WAVETABLE_CHECKSUM_NONE 0
+#define WAVETABLE_CHECKSUM_PRO3 1 /* 16-bit sum of little-endian words, sent as bits 0-6 and 8-14 */
+#define WAVETABLE_CHECKSUM_ROLAND 2 /* One byte that makes the sum of the bytes sent, from checksum_start in
+                                     * the header (the address) to the end of the data, a multiple of 128 */
+
+/* The longest header template */
+#define WAVETABLE_LAYOUT_HEADER_MAX 32
+
+typedef struct _WAVETABLE_LAYOUT {
+    int frames; /* Frames sent, from 1 to 16 */
+    int levels; /* Levels sent, from 1 (1024 samples only) to 4 (down to 128 samples) */
+    int repeat[WAVETABLE_LAYOUT_LEVELS]; /* Times each level is sent */
+    int big_endian; /* 1 if the high byte of each sample goes first */
+    int packing; /* A WAVETABLE_PACK_ value */
+    unsigned char header[WAVETABLE_LAYOUT_HEADER_MAX];
+    int header_size;
+    int num_offset; /* Where the wavetable number goes in the header, or -1 */
+    int name_offset; /* Where the name goes in the header, or -1 */
+    int name_size; /* The name is padded with spaces to this many characters */
+    int checksum; /* A WAVETABLE_CHECKSUM_ value */
+    int checksum_start; /* Where a Roland checksum starts in the header, usually at the address */
+    unsigned char footer[4];
+    int footer_size;
+} WavetableLayout;
+
+/* The Pro 3: 16 frames, each of 1024 samples, then 512 once, 256 twice, and 128 eight times,
+ * big-endian, in Sequential packing
+ */
+static const WavetableLayout PRO3_LAYOUT = {
+    .frames = PRO3_WAVES,
+    .levels = 4,
+    .repeat = {1, 1, 2, 8},
+    .big_endian = 1,
+    .packing = WAVETABLE_PACK_SEQUENTIAL,
+    .header = {0xf0, 0x01, 0x31, 0x6a, 0x6c, 0x01, 0x6b, 0x00, ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 0x00},
+    .header_size = 17,
+    .num_offset = 7,
+    .name_offset = 8,
+    .name_size = 8,
+    .checksum = WAVETABLE_CHECKSUM_PRO3,
+    .footer = {0xf7},
+    .footer_size = 1,
+};
+
+/* Defines function(table, num, name, out) to build a message for a static const layout, as
+ * wavetable_layout_build() does
+ */
+#define WAVETABLE_LAYOUT_SERIALIZER(function, layout) \
+    unsigned long function(Wavetable *table, int num, const char *name, unsigned char out[]) \
+    { \
+        return wavetable_layout_build(&(layout), table, num, name, out); \
+    }
+
+/* Function declarations */
+int wavetable_layout_valid(const WavetableLayout *layout);
+unsigned long wavetable_layout_size(const WavetableLayout *layout);
+static inline unsigned long wavetable_layout_build(const WavetableLayout *layout, Wavetable *table, int num,
+                                                   const char *name, unsigned char out[]);
+unsigned long pro3_layout_sysex(Wavetable *table, int num, const char *name, unsigned char out[]);
+
+/* Returns 1 if a layout's counts, sizes, and offsets fit its arrays and the Wavetable, or 0 if
+ * they don't
+ */
+int wavetable_layout_valid(const WavetableLayout *layout)
+{
+    if (layout->frames < 1 || layout->frames > PRO3_WAVES) return 0;
+    if (layout->levels < 1 || layout->levels > WAVETABLE_LAYOUT_LEVELS) return 0;
+    int l;
+    for (l = 0; l < layout->levels; l++) if (layout->repeat[l] < 0) return 0;
+    if (layout->header_size < 0 || layout->header_size > WAVETABLE_LAYOUT_HEADER_MAX) return 0;
+    if (layout->num_offset >= layout->header_size) return 0;
+    if (layout->name_offset >= 0
+        && (layout->name_size < 0 || layout->name_offset + layout->name_size > layout->header_size)) return 0;
+    if (layout->footer_size < 0 || layout->footer_size > (int) sizeof(layout->footer)) return 0;
+    if (layout->packing < WAVETABLE_PACK_NONE || layout->packing > WAVETABLE_PACK_NIBBLES) return 0;
+    if (layout->checksum < WAVETABLE_CHECKSUM_NONE || layout->checksum > WAVETABLE_CHECKSUM_ROLAND) return 0;
+    if (layout->checksum_start < 0 || layout->checksum_start > layout->header_size) return 0;
+    return 1;
+}
+
+/* Returns the size of a layout's message, in bytes, or 0 if the layout isn't valid */
+unsigned long wavetable_layout_size(const WavetableLayout *layout)
+{
+    if (!wavetable_layout_valid(layout)) return 0;
+    unsigned long words = 0;
+    int l;
+    for (l = 0; l < layout->levels; l++) words += (unsigned long) (PRO3_SAMPLE_SIZE >> l) * layout->repeat[l];
+    unsigned long data = words * 2 * layout->frames;
+    if (layout->packing == WAVETABLE_PACK_SEQUENTIAL) data = ((data / 7) * 8) + ((data % 7) ? (data % 7) + 1 : 0);
+    if (layout->packing == WAVETABLE_PACK_NIBBLES) data *= 2;
+    int checksum = 0;
+    if (layout->checksum == WAVETABLE_CHECKSUM_PRO3) checksum = 2;
+    if (layout->checksum == WAVETABLE_CHECKSUM_ROLAND) checksum = 1;
+    return layout->header_size + data + checksum + layout->footer_size;
+}
+
+/* Packs size words, in the layout's byte order and packing. The Pro3Packer keeps the packing
+ * state and the 16-bit sum of the words, read little-endian.
+ */
+static inline void _wavetable_layout_words(const WavetableLayout *layout, Pro3Packer *packer,
+                                           const pcm_sample_t words[], unsigned long size)
+{
+    if (layout->packing == WAVETABLE_PACK_SEQUENTIAL && layout->big_endian) {
+        _pro3_pack_words(packer, words, size);
+        return;
+    }
+
+    uint32_t checksum = 0;
+    unsigned long i;
+    for (i = 0; i < size; i++)
+    {
+        uint16_t w = (uint16_t) (int16_t) words[i];
+        unsigned char first = layout->big_endian ? (w >> 8) : (w & 0xff);
+        unsigned char second = layout->big_endian ? (w & 0xff) : (w >> 8);
+        checksum += first | (second << 8);
+        if (layout->packing == WAVETABLE_PACK_SEQUENTIAL) {
+            _pro3_pack_byte(packer, first);
+            _pro3_pack_byte(packer, second);
+        } else if (layout->packing == WAVETABLE_PACK_NIBBLES) {
+            *(packer->out++) = first >> 4;
+            *(packer->out++) = first & 0x0f;
+            *(packer->out++) = second >> 4;
+            *(packer->out++) = second & 0x0f;
+        } else {
+            *(packer->out++) = first;
+            *(packer->out++) = second;
+        }
+    }
+    packer->checksum += checksum;
+}
+
+/*
+ * Builds the message for a Wavetable in a layout, into out[], which needs room for
+ * wavetable_layout_size() bytes, and returns its size. The zero-indexed wavetable number and the
+ * name go into the header, where the layout has room for them. Frame f is the Wavetable's
+ * waveform f * 15 / (frames - 1), so the first and last waveforms are always sent. Nothing is
+ * built, and 0 is returned, if the layout isn't valid (see wavetable_layout_valid()).
+ *
+ * This is static inline so that, for a static const layout, the compiler can fold in the layout's
+ * values and leave out the paths that the layout doesn't use.
+ */
+static inline unsigned long wavetable_layout_build(const WavetableLayout *layout, Wavetable *table, int num,
+                                                   const char *name, unsigned char out[])
+{
+    if (!wavetable_layout_valid(layout)) return 0;
+    memcpy(out, layout->header, layout->header_size);
+    if (layout->num_offset >= 0) out[layout->num_offset] = num;
+    if (layout->name_offset >= 0) {
+        int length = strlen(name);
+        int c;
+        for (c = 0; c < layout->name_size; c++) out[layout->name_offset + c] = (c < length) ? name[c] : ' ';
+    }
+
+    Pro3Packer packer;
+    packer.out = out + layout->header_size;
+    packer.head = packer.out;
+    packer.packbyte = 0;
+    packer.pos = 0;
+    packer.checksum = 0;
+
+    int f;
+    for (f = 0; f < layout->frames; f++)
+    {
+        int k = (layout->frames > 1) ? (f * (PRO3_WAVES - 1)) / (layout->frames - 1) : 0;
+        const pcm_sample_t *level = table->ref[k];
+        const pcm_sample_t *mip = (layout->levels > 1) ? wavetable_mips(table, k) : NULL;
+        int l;
+        for (l = 0; l < layout->levels; l++)
+        {
+            unsigned long level_size = PRO3_SAMPLE_SIZE >> l;
+            int j;
+            for (j = 0; j < layout->repeat[l]; j++) _wavetable_layout_words(layout, &packer, level, level_size);
+            level = (l == 0) ? mip : level + level_size;
+        }
+    }
+
+    /* Finish the last packet, which may be short */
+    if (layout->packing == WAVETABLE_PACK_SEQUENTIAL && packer.pos) *(packer.head) = packer.packbyte;
+    unsigned long size = packer.out - out;
+
+    if (layout->checksum == WAVETABLE_CHECKSUM_PRO3) {
+        uint16_t checksum = (uint16_t) packer.checksum;
+        out[size++] = checksum & 0x7f;
+        out[size++] = (checksum >> 8) & 0x7f;
+    } else if (layout->checksum == WAVETABLE_CHECKSUM_ROLAND) {
+        /* Roland's checksum covers the bytes as they're sent, so it's taken after packing */
+        uint32_t byte_sum = 0;
+        unsigned long i;
+        for (i = layout->checksum_start; i < size; i++) byte_sum += out[i];
+        out[size++] = (128 - (byte_sum & 0x7f)) & 0x7f;
+    }
+
+    memcpy(out + size, layout->footer, layout->footer_size);
+    return size + layout->footer_size;
+}
+
+/* Builds a Pro 3 message, which is the same as the one wavetable_sysex() builds */
+WAVETABLE_LAYOUT_SERIALIZER(pro3_layout_sysex, PRO3_LAYOUT)
+
+#endif /* WAVETABLE_LAYOUT_H_ */
+
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
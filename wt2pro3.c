@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2020 The Beige Maze Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* wt2pro3 converts every multi-frame wavetable WAV file in a directory (as made by
+ * Serum, Vital, and others) into a Pro 3 wavetable system exclusive file of the same
+ * name in another directory. The cycle length comes from each file's 'clm ' chunk, or
+ * is 2048 samples (or the length given) if there isn't one. Every whole frame in a file
+ * is used, however many there are. Files are converted on a pool of threads.
+ *
+ *   wt2pro3 ~/Serum/Tables ~/Pro3/Tables 33
+ *   wt2pro3 ~/Tables ~/Pro3 40 8 1024
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "pcm_stream.h"
+#include "pro3_wavetable.h"
+
+#define DEFAULT_CYCLE 2048
+#define MAX_THREADS 64
+#define THREAD_STACK (16 * 1024 * 1024) /* Making the mip levels takes a few MB */
+
+/* The work shared by the converter threads */
+typedef struct _Batch {
+    const char *in_dir;
+    const char *out_dir;
+    char **files;
+    int count;
+    int num; /* Zero-indexed wavetable number */
+    pcm_size_t cycle; /* Cycle length for files without a 'clm ' chunk */
+    atomic_int next; /* The next file to take */
+    atomic_int converted;
+} Batch;
+
+/* Converts one WAV file. Returns 1 if it was converted. */
+int convert(Batch *batch, const char *file_name, Wavetable *table, unsigned char sysex[])
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", batch->in_dir, file_name);
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "%s: can't open\n", path);
+        return 0;
+    }
+
+    WAVStream ws;
+    if (!wav_stream_open(&ws, in)) {
+        fprintf(stderr, "%s: not a WAV file this can read\n", file_name);
+        fclose(in);
+        return 0;
+    }
+    pcm_size_t cycle = ws.cycle ? ws.cycle : batch->cycle;
+    /* Read every whole frame, so the last frame of the file is the last frame of the table */
+    pcm_size_t frames = (pcm_size_t) ws.frames;
+    if (frames < cycle) cycle = frames; /* A file shorter than a cycle is one cycle */
+    if (cycle) frames -= frames % cycle;
+    pcm_sample_t *data = (pcm_sample_t *) malloc(sizeof(pcm_sample_t) * (frames ? frames : 1) * ws.meta.channels);
+    if (data == NULL) {
+        fprintf(stderr, "%s: not enough memory to read it\n", file_name);
+        fclose(in);
+        return 0;
+    }
+    frames = wav_stream_read(&ws, data, frames);
+    fclose(in);
+
+    PCMSlice source;
+    source.data = data;
+    source.size = frames;
+    source.channels = ws.meta.channels;
+    source.stride = ws.meta.channels;
+    source.resolution = ws.meta.resolution;
+    source.rate = ws.meta.rate;
+    *table = new_Wavetable();
+    int count = wavetable_from_frames(table, source, cycle);
+    free(data);
+    if (count == 0) {
+        fprintf(stderr, "%s: no whole frames\n", file_name);
+        return 0;
+    }
+
+    /* The name is the file name, without its extension, cut to 8 characters */
+    char name[9];
+    snprintf(name, sizeof(name), "%s", file_name);
+    char *dot = strchr(name, '.');
+    if (dot) *dot = '\0';
+    unsigned long size = wavetable_sysex(table, batch->num, name, sysex);
+
+    int length = strlen(file_name);
+    snprintf(path, sizeof(path), "%s/%.*s.syx", batch->out_dir, length > 4 ? length - 4 : length, file_name);
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: can't open for writing\n", path);
+        return 0;
+    }
+    int ok = (fwrite(sysex, 1, size, out) == size);
+    if (fclose(out)) ok = 0;
+    if (!ok) fprintf(stderr, "%s: couldn't be written\n", path);
+    return ok;
+}
+
+/* Each converter thread takes the next file that hasn't been taken, until they've all been taken */
+void *converter(void *arg)
+{
+    Batch *batch = (Batch *) arg;
+    Wavetable *table = (Wavetable *) malloc(sizeof(Wavetable));
+    unsigned char *sysex = (unsigned char *) malloc(PRO3_SYSEX_SIZE);
+    if (table != NULL && sysex != NULL) {
+        int f;
+        while ((f = atomic_fetch_add(&batch->next, 1)) < batch->count)
+        {
+            if (convert(batch, batch->files[f], table, sysex)) atomic_fetch_add(&batch->converted, 1);
+        }
+    }
+    free(table);
+    free(sysex);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        printf("\nusage: %s in_directory out_directory wavetable_number [threads] [cycle_length]\n\n", argv[0]);
+        return -1;
+    }
+    int wavetable_number = atoi(argv[3]);
+    if (wavetable_number > 64 || wavetable_number < 33) {
+        printf("\nwavetable number out of range (33-64)\n\n");
+        return -1;
+    }
+    int threads = (argc > 4) ? atoi(argv[4]) : 4;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    Batch batch;
+    batch.in_dir = argv[1];
+    batch.out_dir = argv[2];
+    batch.num = wavetable_number - 1; /* Because wavetable numbers are zero-indexed to the Pro3 */
+    batch.cycle = (argc > 5) ? atol(argv[5]) : DEFAULT_CYCLE;
+    batch.count = 0;
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.converted, 0);
+    if (batch.cycle < 2) {
+        printf("\ncycle length out of range\n\n");
+        return -1;
+    }
+
+    /* List the WAV files */
+    DIR *dir = opendir(batch.in_dir);
+    if (dir == NULL) {
+        printf("\ncan't open %s\n\n", batch.in_dir);
+        return -1;
+    }
+    int room = 256;
+    batch.files = (char **) malloc(sizeof(char *) * room);
+    struct dirent *entry;
+    while (batch.files != NULL && (entry = readdir(dir)) != NULL)
+    {
+        int length = strlen(entry->d_name);
+        if (length < 5 || strcasecmp(entry->d_name + length - 4, ".wav")) continue;
+        if (batch.count == room) {
+            room *= 2;
+            char **more = (char **) realloc(batch.files, sizeof(char *) * room);
+            if (more == NULL) break;
+            batch.files = more;
+        }
+        batch.files[batch.count++] = strdup(entry->d_name);
+    }
+    closedir(dir);
+    if (batch.files == NULL) return -1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t pool[MAX_THREADS];
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, THREAD_STACK);
+    int started = 0;
+    while (started < threads && pthread_create(&pool[started], &attr, converter, &batch) == 0) started++;
+    pthread_attr_destroy(&attr);
+    if (started == 0) converter(&batch);
+    int t;
+    for (t = 0; t < started; t++) pthread_join(pool[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    int converted = atomic_load(&batch.converted);
+    fprintf(stderr, "converted %d of %d files in %.2f s on %d threads\n", converted, batch.count, seconds, started ? started : 1);
+
+    int f;
+    for (f = 0; f < batch.count; f++) free(batch.files[f]);
+    free(batch.files);
+    return (converted == batch.count) ? 0 : 1;
+}